@@ -1,11 +1,42 @@
-#include <unistd.h>     // fork, execvp, getpid
-#include <sys/wait.h>   // waitpid, WIFEXITED, WEXITSTATUS, WIFSIGNALED, WTERMSIG
+#define _GNU_SOURCE
+#include <unistd.h>     // fork, execvp, getpid, close, syscall, read, write, dup2, getopt
+#include <fcntl.h>      // pipe2, fcntl, open, O_NONBLOCK, O_CLOEXEC
+#include <sys/stat.h>   // mkdir
+#include <sys/wait.h>   // wait4, waitid, WIFEXITED, WEXITSTATUS, WIFSIGNALED, WTERMSIG
+#include <sys/resource.h> // struct rusage
+#include <sys/epoll.h>  // epoll_create1, epoll_ctl, epoll_wait
+#include <sys/syscall.h> // SYS_pidfd_open
 #include <stdio.h>      // printf, perror
-#include <stdlib.h>     // exit, abort
+#include <stdlib.h>     // exit, abort, malloc, atol
+#include <string.h>     // memcpy, strcmp
+#include <errno.h>      // errno, EAGAIN, EINTR, EEXIST
 #include <signal.h>     // SIGABRT (for clarity)
+#include <time.h>       // clock_gettime
 
 #define NUM_CHILDREN 15
 
+// Summary counts
+static int exit0_count = 0;
+static int exit_nonzero_count = 0;
+static int signal_term_count = 0;
+
+// Fork time of each child, to report fork-to-exit latency
+static struct timespec forkTime[NUM_CHILDREN];
+
+// What each child cost, collected by wait4 when it is reaped
+typedef struct {
+    double wallMs;      // fork to reap
+    double userMs;      // user CPU
+    double sysMs;       // system CPU
+    long maxRssKb;      // peak resident set
+    long minFlt;        // page faults served without I/O
+    long majFlt;        // page faults that needed I/O
+    long volCsw;        // gave up the CPU (blocked, e.g. on I/O)
+    long involCsw;      // was preempted
+} ChildUsage;
+
+static ChildUsage usage[NUM_CHILDREN];
+
 // Runs a command using execvp. If execvp fails, this function exits with 127.
 static void run_exec(char *argv[]) {
     execvp(argv[0], argv);          // Replace current process image with new program
@@ -13,14 +44,471 @@ static void run_exec(char *argv[]) {
     exit(127);                      // Non-zero exit code for command failure
 }
 
-int main(void) {
+// Milliseconds from start until now
+static double ms_since(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1e3 + (now.tv_nsec - start->tv_nsec) / 1e6;
+}
+
+// Report how one child terminated (required) and count it.
+// rank is its place in completion order, starting at 1.
+static void report_child(int rank, int i, pid_t pid, int status) {
+    double ms = usage[i].wallMs;
+
+    if (WIFEXITED(status)) {
+        int code = WEXITSTATUS(status);
+        printf("#%-2d Child %d (PID=%d) EXITED normally | code=%d | %.2f ms after fork\n",
+               rank, i, (int)pid, code, ms);
+
+        if (code == 0) exit0_count++;
+        else exit_nonzero_count++;
+    } else if (WIFSIGNALED(status)) {
+        printf("#%-2d Child %d (PID=%d) TERMINATED by signal | signal=%d | %.2f ms after fork\n",
+               rank, i, (int)pid, WTERMSIG(status), ms);
+        signal_term_count++;
+    }
+}
+
+static double tv_ms(struct timeval tv) {
+    return tv.tv_sec * 1e3 + tv.tv_usec / 1e3;
+}
+
+// Reap child i with wait4 so we get its resource usage along with its
+// status, then report it. The child has already exited, so this doesn't block.
+static void reap_child(int rank, int i, pid_t pid) {
+    int status;
+    struct rusage ru;
+
+    if (wait4(pid, &status, 0, &ru) < 0) {
+        perror("wait4 failed");
+        exit(1);
+    }
+
+    ChildUsage *u = &usage[i];
+    u->wallMs = ms_since(&forkTime[i]);
+    u->userMs = tv_ms(ru.ru_utime);
+    u->sysMs = tv_ms(ru.ru_stime);
+    u->maxRssKb = ru.ru_maxrss;         // Linux reports this in KB
+    u->minFlt = ru.ru_minflt;
+    u->majFlt = ru.ru_majflt;
+    u->volCsw = ru.ru_nvcsw;
+    u->involCsw = ru.ru_nivcsw;
+
+    report_child(rank, i, pid, status);
+}
+
+// Open a pidfd for the child; -1 if the kernel doesn't have pidfd_open (< 5.3)
+static int open_pidfd(pid_t pid) {
+#ifdef SYS_pidfd_open
+    return (int)syscall(SYS_pidfd_open, pid, 0);
+#else
+    (void)pid;
+    return -1;
+#endif
+}
+
+// ---------------- output capture ----------------
+
+// Each child's stdout and stderr go to their own pipe. The parent reads
+// every pipe non-blocking from the same epoll loop that reaps children, so
+// a child that prints a lot never stalls on a full pipe and the parent
+// never waits on any one child. Output modes:
+//   grouped  each child's output printed in one block once it is done
+//   prefix   lines printed as they arrive, tagged with child and stream
+//   files    written straight to DIR/child<i>.out and DIR/child<i>.err
+enum { OUT_GROUPED, OUT_PREFIX, OUT_FILES };
+
+static int outputMode = OUT_GROUPED;
+static const char *spillDir = "lab2_output";
+static size_t ringSize = 64 * 1024;
+
+// Bounded buffer for one stream. When it fills, the oldest bytes are
+// dropped, so a chatty child keeps its last ringSize bytes. Prefix mode
+// never fills it: lines leave before more data comes in.
+typedef struct {
+    char *buf;
+    size_t start;       // oldest byte
+    size_t len;
+    size_t total;       // everything the child wrote
+    size_t dropped;
+} Ring;
+
+typedef struct {
+    int fd[2];          // read ends: stdout, stderr (-1 once at EOF)
+    int file[2];        // files mode: where the stream goes
+    Ring ring[2];
+    int exited;
+} Capture;
+
+static Capture capture[NUM_CHILDREN];
+static const char *streamName[2] = {"out", "err"};
+
+static void ring_put(Ring *r, const char *data, size_t n) {
+    r->total += n;
+    if (n >= ringSize) {
+        // only the tail of this chunk fits
+        r->dropped += r->len + (n - ringSize);
+        data += n - ringSize;
+        n = ringSize;
+        r->start = 0;
+        r->len = 0;
+    } else if (r->len + n > ringSize) {
+        size_t drop = r->len + n - ringSize;
+        r->start = (r->start + drop) % ringSize;
+        r->len -= drop;
+        r->dropped += drop;
+    }
+
+    // copy in at the end, wrapping around once at most
+    size_t end = (r->start + r->len) % ringSize;
+    size_t first = n < ringSize - end ? n : ringSize - end;
+    memcpy(r->buf + end, data, first);
+    memcpy(r->buf, data + first, n - first);
+    r->len += n;
+}
+
+// Offset of the first newline, or -1
+static long ring_find_newline(const Ring *r) {
+    for (size_t k = 0; k < r->len; k++)
+        if (r->buf[(r->start + k) % ringSize] == '\n') return (long)k;
+    return -1;
+}
+
+// Write the oldest n bytes to out and drop them from the ring
+static void ring_emit(Ring *r, size_t n, FILE *out) {
+    size_t first = n < ringSize - r->start ? n : ringSize - r->start;
+    fwrite(r->buf + r->start, 1, first, out);
+    fwrite(r->buf, 1, n - first, out);
+    r->start = (r->start + n) % ringSize;
+    r->len -= n;
+}
+
+// Prefix mode: print every complete line in the ring. At EOF (or when one
+// line fills the whole ring) the partial line is printed as well.
+static void emit_lines(int i, int s, int flush) {
+    Ring *r = &capture[i].ring[s];
+    FILE *out = s == 0 ? stdout : stderr;
+    long nl;
+
+    while ((nl = ring_find_newline(r)) >= 0) {
+        fprintf(out, "[child %d %s] ", i, streamName[s]);
+        ring_emit(r, (size_t)nl + 1, out);
+    }
+    if (r->len > 0 && (flush || r->len == ringSize)) {
+        fprintf(out, "[child %d %s] ", i, streamName[s]);
+        ring_emit(r, r->len, out);
+        fputc('\n', out);
+    }
+}
+
+// Grouped mode: once the child is reaped and both pipes hit EOF, print
+// everything it wrote as one block
+static void emit_group(int i) {
+    Capture *c = &capture[i];
+    if (outputMode != OUT_GROUPED || !c->exited || c->fd[0] >= 0 || c->fd[1] >= 0) return;
+
+    for (int s = 0; s < 2; s++) {
+        Ring *r = &c->ring[s];
+        if (r->total == 0) continue;
+
+        printf("    ---- Child %d std%s (%zu bytes", i, streamName[s], r->total);
+        if (r->dropped) printf(", first %zu dropped", r->dropped);
+        printf(") ----\n");
+        ring_emit(r, r->len, stdout);
+        if (r->total && r->buf[(r->start + ringSize - 1) % ringSize] != '\n') printf("\n");
+    }
+}
+
+// Make both pipes for child i before it is forked. O_CLOEXEC keeps later
+// children from inheriting them (which would delay EOF); dup2 in the child
+// clears it on the copies that become its stdout and stderr.
+static void capture_open(int i, int writeEnd[2]) {
+    Capture *c = &capture[i];
+
+    for (int s = 0; s < 2; s++) {
+        int p[2];
+        if (pipe2(p, O_CLOEXEC) < 0) {
+            perror("pipe2 failed");
+            exit(1);
+        }
+        // the parent only ever reads when epoll says there is data,
+        // and stops at EAGAIN instead of waiting for more
+        fcntl(p[0], F_SETFL, O_NONBLOCK);
+        c->fd[s] = p[0];
+        writeEnd[s] = p[1];
+        c->file[s] = -1;
+
+        if (outputMode == OUT_FILES) {
+            char path[4096];
+            snprintf(path, sizeof(path), "%s/child%d.%s", spillDir, i, streamName[s]);
+            c->file[s] = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+            if (c->file[s] < 0) {
+                perror(path);
+                exit(1);
+            }
+        } else {
+            c->ring[s].buf = malloc(ringSize);
+            if (!c->ring[s].buf) {
+                perror("malloc");
+                exit(1);
+            }
+        }
+    }
+}
+
+// Read whatever is in one pipe without blocking. Returns 1 at EOF.
+static int capture_drain(int i, int s) {
+    Capture *c = &capture[i];
+    char chunk[16384];
+
+    for (;;) {
+        ssize_t n = read(c->fd[s], chunk, sizeof(chunk));
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && errno == EAGAIN) return 0;
+        if (n <= 0) return 1;       // EOF, or an error we treat the same
+
+        if (outputMode == OUT_FILES) {
+            c->ring[s].total += (size_t)n;
+            if (write(c->file[s], chunk, (size_t)n) != n) perror("write to spill file");
+        } else if (outputMode == OUT_PREFIX) {
+            // a chunk can be bigger than the ring: feed it in pieces that
+            // fit and print the lines out of each before taking the next
+            Ring *r = &c->ring[s];
+            for (size_t done = 0; done < (size_t)n;) {
+                size_t take = (size_t)n - done;
+                if (take > ringSize - r->len) take = ringSize - r->len;
+                ring_put(r, chunk + done, take);
+                emit_lines(i, s, 0);
+                done += take;
+            }
+        } else {
+            ring_put(&c->ring[s], chunk, (size_t)n);
+        }
+    }
+}
+
+// A pipe hit EOF: the child (and anything it started) closed its end
+static void capture_close(int i, int s) {
+    Capture *c = &capture[i];
+
+    close(c->fd[s]);
+    c->fd[s] = -1;
+    if (outputMode == OUT_PREFIX) emit_lines(i, s, 1);
+    if (c->file[s] >= 0) close(c->file[s]);
+    emit_group(i);
+}
+
+// ---------------- reaping ----------------
+
+// epoll data for a pipe: past the child indexes, two per child
+#define PIPE_TAG(i, s) ((unsigned)(NUM_CHILDREN + 2 * (i) + (s)))
+
+// Reap children as they finish while draining their output. Each pidfd
+// turns readable when its child exits, so epoll hands children back in
+// completion order. Without pidfds (kernel < 5.3) epoll only watches the
+// pipes with a short timeout, and waitid(WNOHANG) picks up exits between
+// wakeups, which keeps the parent from blocking on either.
+static void reap_children(const pid_t childPids[]) {
+    int pidfd[NUM_CHILDREN];
+    int usePidfd = 1;
+    int openPipes = 0;
+    int ep = epoll_create1(EPOLL_CLOEXEC);
+    if (ep < 0) {
+        perror("epoll_create1 failed");
+        exit(1);
+    }
+
+    for (int i = 0; i < NUM_CHILDREN; i++) {
+        pidfd[i] = usePidfd ? open_pidfd(childPids[i]) : -1;
+        if (pidfd[i] < 0 && usePidfd) {
+            // no pidfds here: undo and poll with waitid instead
+            for (int j = 0; j < i; j++) {
+                epoll_ctl(ep, EPOLL_CTL_DEL, pidfd[j], NULL);
+                close(pidfd[j]);
+                pidfd[j] = -1;
+            }
+            usePidfd = 0;
+            printf("(pidfd_open not available, falling back to waitid)\n");
+        }
+
+        struct epoll_event ev = {0};
+        ev.events = EPOLLIN;
+        if (pidfd[i] >= 0) {
+            ev.data.u32 = (unsigned)i;   // remember which child this fd is
+            if (epoll_ctl(ep, EPOLL_CTL_ADD, pidfd[i], &ev) < 0) {
+                perror("epoll_ctl failed");
+                exit(1);
+            }
+        }
+        for (int s = 0; s < 2; s++) {
+            ev.data.u32 = PIPE_TAG(i, s);
+            if (epoll_ctl(ep, EPOLL_CTL_ADD, capture[i].fd[s], &ev) < 0) {
+                perror("epoll_ctl failed");
+                exit(1);
+            }
+            openPipes++;
+        }
+    }
+
+    int reaped = 0;
+    while (reaped < NUM_CHILDREN || openPipes > 0) {
+        struct epoll_event ready[3 * NUM_CHILDREN];
+        int timeout = usePidfd || reaped == NUM_CHILDREN ? -1 : 10;
+        int n = epoll_wait(ep, ready, 3 * NUM_CHILDREN, timeout);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("epoll_wait failed");
+            exit(1);
+        }
+
+        for (int k = 0; k < n; k++) {
+            unsigned tag = ready[k].data.u32;
+
+            if (tag < NUM_CHILDREN) {
+                int i = (int)tag;
+
+                // The child is a zombie now, so this returns right away
+                reap_child(++reaped, i, childPids[i]);
+                capture[i].exited = 1;
+                emit_group(i);
+
+                epoll_ctl(ep, EPOLL_CTL_DEL, pidfd[i], NULL);
+                close(pidfd[i]);
+            } else {
+                int i = (int)(tag - NUM_CHILDREN) / 2, s = (int)(tag - NUM_CHILDREN) % 2;
+                if (capture_drain(i, s)) {
+                    epoll_ctl(ep, EPOLL_CTL_DEL, capture[i].fd[s], NULL);
+                    capture_close(i, s);
+                    openPipes--;
+                }
+            }
+        }
+
+        // Fallback: waitid(P_ALL) returns whichever child finished, which
+        // is also completion order. WNOWAIT leaves it to be reaped by
+        // wait4, since waitid can't hand back the resource usage.
+        while (!usePidfd && reaped < NUM_CHILDREN) {
+            siginfo_t info;
+            info.si_pid = 0;
+            if (waitid(P_ALL, 0, &info, WEXITED | WNOHANG | WNOWAIT) < 0) {
+                perror("waitid failed");
+                exit(1);
+            }
+            if (info.si_pid == 0) break;    // nobody else has exited yet
+
+            // Map the PID back to its child index
+            int i = 0;
+            while (i < NUM_CHILDREN && childPids[i] != info.si_pid) i++;
+            if (i == NUM_CHILDREN) {
+                // not one of ours: just reap it
+                waitpid(info.si_pid, NULL, 0);
+                continue;
+            }
+
+            reap_child(++reaped, i, info.si_pid);
+            capture[i].exited = 1;
+            emit_group(i);
+        }
+    }
+
+    close(ep);
+}
+
+// ---------------- resource usage summary ----------------
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Print total, mean, p50, p90, p99 and max of one usage column.
+// v is sorted in place.
+static void print_stat_row(const char *name, double v[], int n) {
+    double total = 0;
+    for (int k = 0; k < n; k++) total += v[k];
+    qsort(v, (size_t)n, sizeof(double), cmp_double);
+
+    // nearest-rank percentiles
+    int p50 = (int)(0.50 * n + 0.999999) - 1;
+    int p90 = (int)(0.90 * n + 0.999999) - 1;
+    int p99 = (int)(0.99 * n + 0.999999) - 1;
+
+    printf("%-18s %10.2f %10.2f %10.2f %10.2f %10.2f %10.2f\n",
+           name, total, total / n, v[p50], v[p90], v[p99], v[n - 1]);
+}
+
+// Per-child table plus aggregates, so expensive children stand out
+static void print_usage_summary(const pid_t childPids[]) {
+    printf("\n--- Resource usage per child (wait4) ---\n");
+    printf("%-5s %7s %9s %8s %8s %9s %7s %7s %7s %7s\n", "Child", "PID", "wall ms",
+           "user ms", "sys ms", "maxRSS KB", "minflt", "majflt", "vcsw", "ivcsw");
+    for (int i = 0; i < NUM_CHILDREN; i++) {
+        const ChildUsage *u = &usage[i];
+        printf("%-5d %7d %9.2f %8.2f %8.2f %9ld %7ld %7ld %7ld %7ld\n", i, (int)childPids[i],
+               u->wallMs, u->userMs, u->sysMs, u->maxRssKb, u->minFlt, u->majFlt,
+               u->volCsw, u->involCsw);
+    }
+
+    printf("\n%-18s %10s %10s %10s %10s %10s %10s\n",
+           "", "total", "mean", "p50", "p90", "p99", "max");
+
+    // Pull out one column at a time and summarize it
+    double v[NUM_CHILDREN];
+    int cpuMax = 0;
+#define USAGE_ROW(name, expr)                                   \
+    do {                                                        \
+        for (int i = 0; i < NUM_CHILDREN; i++) {                \
+            const ChildUsage *u = &usage[i];                    \
+            v[i] = (double)(expr);                              \
+        }                                                       \
+        print_stat_row(name, v, NUM_CHILDREN);                  \
+    } while (0)
+
+    USAGE_ROW("wall ms", u->wallMs);
+    USAGE_ROW("user ms", u->userMs);
+    USAGE_ROW("sys ms", u->sysMs);
+    USAGE_ROW("cpu ms (user+sys)", u->userMs + u->sysMs);
+    USAGE_ROW("max RSS KB", u->maxRssKb);
+    USAGE_ROW("minor faults", u->minFlt);
+    USAGE_ROW("major faults", u->majFlt);
+    USAGE_ROW("voluntary csw", u->volCsw);
+    USAGE_ROW("involuntary csw", u->involCsw);
+#undef USAGE_ROW
+
+    // Most expensive child by CPU time
+    for (int i = 1; i < NUM_CHILDREN; i++)
+        if (usage[i].userMs + usage[i].sysMs > usage[cpuMax].userMs + usage[cpuMax].sysMs) cpuMax = i;
+    printf("\nMost CPU: Child %d (PID=%d) | %.2f ms user + %.2f ms sys | maxRSS %ld KB\n",
+           cpuMax, (int)childPids[cpuMax], usage[cpuMax].userMs, usage[cpuMax].sysMs,
+           usage[cpuMax].maxRssKb);
+    printf("(total for max RSS is a sum of peaks, not memory in use at one time)\n");
+}
+
+// Usage: ./Lab2 [-o grouped|prefix|files] [-d dir] [-b ring-bytes]
+//   -o  how captured child output is shown (default grouped)
+//   -d  directory for -o files (default lab2_output)
+//   -b  bytes kept per stream in grouped/prefix mode (default 65536)
+int main(int argc, char *argv[]) {
     pid_t childPids[NUM_CHILDREN];  // Store child PIDs in creation order
-    int status;                     // Status returned by waitpid
+    int opt;
+
+    while ((opt = getopt(argc, argv, "o:d:b:")) != -1) {
+        if (opt == 'o' && strcmp(optarg, "grouped") == 0) outputMode = OUT_GROUPED;
+        else if (opt == 'o' && strcmp(optarg, "prefix") == 0) outputMode = OUT_PREFIX;
+        else if (opt == 'o' && strcmp(optarg, "files") == 0) outputMode = OUT_FILES;
+        else if (opt == 'd') spillDir = optarg;
+        else if (opt == 'b' && atol(optarg) > 0) ringSize = (size_t)atol(optarg);
+        else {
+            fprintf(stderr, "Usage: %s [-o grouped|prefix|files] [-d dir] [-b ring-bytes]\n", argv[0]);
+            return 1;
+        }
+    }
 
-    // Summary counts
-    int exit0_count = 0;
-    int exit_nonzero_count = 0;
-    int signal_term_count = 0;
+    if (outputMode == OUT_FILES && mkdir(spillDir, 0755) < 0 && errno != EEXIST) {
+        perror(spillDir);
+        return 1;
+    }
 
     // Print parent PID at start 
     printf("Parent PID: %d\n\n", (int)getpid());
@@ -45,6 +533,11 @@ int main(void) {
 
     // Create 15 children using fork inside a loop
     for (int i = 0; i < NUM_CHILDREN; i++) {
+        int writeEnd[2];
+        capture_open(i, writeEnd);
+
+        fflush(stdout);             // so the child doesn't inherit unprinted output
+        clock_gettime(CLOCK_MONOTONIC, &forkTime[i]);
         pid_t pid = fork();
 
         // fork error handling
@@ -57,6 +550,10 @@ int main(void) {
             // CHILD PROCESS
             pid_t myPid = getpid();
 
+            // stdout and stderr go to this child's capture pipes
+            dup2(writeEnd[0], STDOUT_FILENO);
+            dup2(writeEnd[1], STDERR_FILENO);
+
             // Print child index, PID, and the command it will execute.
             printf("Child %d | PID=%d | ", i, (int)myPid);
 
@@ -89,35 +586,24 @@ int main(void) {
         } else {
             // PARENT PROCESS stores PID in array in creation order.
             childPids[i] = pid;
+
+            // Only the child writes; our copies would keep the pipes from hitting EOF
+            close(writeEnd[0]);
+            close(writeEnd[1]);
         }
     }
 
-    printf("\n--- Parent waiting in CREATION order (waitpid on stored PIDs) ---\n");
+    // Parent reaps children in the order they finish, so one slow child
+    // (like ps aux) doesn't hold up reporting the ones already done
+    printf("\n--- Parent reaping in COMPLETION order (pidfd + epoll) ---\n");
+    reap_children(childPids);
 
-    // Parent waits for children in the order created 
+    if (outputMode == OUT_FILES) {
+        printf("\nChild output written to %s/child<N>.out and .err\n", spillDir);
+    }
     for (int i = 0; i < NUM_CHILDREN; i++) {
-        pid_t w = waitpid(childPids[i], &status, 0);
-
-        if (w < 0) {
-            // waitpid error handling
-            perror("waitpid failed");
-            exit(1);
-        }
-
-        // Report how each child terminated (required)
-        if (WIFEXITED(status)) {
-            int code = WEXITSTATUS(status);
-            printf("Child %d (PID=%d) EXITED normally | code=%d\n",
-                   i, (int)childPids[i], code);
-
-            if (code == 0) exit0_count++;
-            else exit_nonzero_count++;
-        } else if (WIFSIGNALED(status)) {
-            int sig = WTERMSIG(status);
-            printf("Child %d (PID=%d) TERMINATED by signal | signal=%d\n",
-                   i, (int)childPids[i], sig);
-            signal_term_count++;
-        } 
+        free(capture[i].ring[0].buf);
+        free(capture[i].ring[1].buf);
     }
 
     // Print summary counts
@@ -126,8 +612,11 @@ int main(void) {
     printf("Exit normally with non-zero code: %d\n", exit_nonzero_count);
     printf("Terminated by signal: %d\n", signal_term_count);
 
+    print_usage_summary(childPids);
+
     // Small note about order difference 
-    printf("\nNote: Children are created in a fixed order, but they may finish in a different order.\n");
+    printf("\nNote: Children are created in a fixed order, but they may finish in a different order;\n"
+           "the # column above is the order they actually finished in.\n");
 
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,504 @@
+/*
+    launcher.c
+    Bounded-concurrency job launcher (Lab2.c generalized)
+
+    Lab2.c forks a fixed list of 15 children all at once. This reads a job
+    list of any length and keeps at most N children running: whenever one
+    exits its slot is refilled with the next job, so thousands of jobs can
+    run without thousands of processes existing at the same time.
+
+    Usage:
+        ./launcher [-j N] [-q] [jobfile]
+
+    -j N   children allowed at once (default 4)
+    -q     quiet: only print failures and the summary
+
+    jobfile (or stdin when missing or "-") holds one job per line:
+        ls -l                        plain command, split on whitespace;
+        echo "Hello Diego Trevino"   '...' and "..." group words
+        {"cmd": ["ps", "aux"]}       JSONL: argv as an array
+        {"cmd": "uname -a"}          JSONL: string, split like a plain line
+    Blank lines and lines starting with '#' are skipped. When the jobs
+    come from stdin, each job gets /dev/null as its stdin instead.
+
+    Children are reaped as they finish through a pidfd per child in an
+    epoll set (waitpid(-1) when pidfds aren't available), and the summary
+    uses the same exit0 / non-zero / signal counts as Lab2.
+*/
+
+#define _GNU_SOURCE
+#include <unistd.h>     // fork, execvp, _exit, close, dup2, syscall, getopt
+#include <fcntl.h>      // open, O_RDONLY
+#include <sys/wait.h>   // waitpid, WIFEXITED, WEXITSTATUS, WIFSIGNALED, WTERMSIG
+#include <sys/epoll.h>  // epoll_create1, epoll_ctl, epoll_wait
+#include <sys/syscall.h> // SYS_pidfd_open
+#include <stdio.h>      // printf, fprintf, perror, getline
+#include <stdlib.h>     // exit, malloc, free, atoi
+#include <string.h>     // strcmp, strcpy
+#include <errno.h>      // errno, EINTR
+#include <time.h>       // clock_gettime
+
+#define MAX_ARGS 256
+#define MAX_SLOTS 4096
+
+typedef struct {
+    long line;              // line number in the job file
+    int argc;
+    char *argv[MAX_ARGS + 1];
+    char *text;             // storage the argv strings point into
+} Job;
+
+// One running child. A slot is free when pid == 0.
+typedef struct {
+    pid_t pid;
+    int pidfd;
+    long jobNo;             // 1-based job number in launch order
+    long line;
+    char name[64];          // short command text for the report
+    struct timespec start;
+} Slot;
+
+// Summary counts (same categories as Lab2)
+static long exit0_count = 0;
+static long exit_nonzero_count = 0;
+static long signal_term_count = 0;
+static long bad_job_count = 0;
+
+static int quiet = 0;
+static int jobs_on_stdin = 0;   // children must not read the job list
+
+// Runs a command using execvp. If execvp fails, this function exits with 127.
+// _exit, not exit: exit would sync the job file's stdio buffer, seeking the
+// offset the child shares with us and making the parent re-read lines.
+static void run_exec(char *argv[]) {
+    execvp(argv[0], argv);
+    perror("execvp failed");
+    _exit(127);
+}
+
+// Milliseconds from start until now
+static double ms_since(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1e3 + (now.tv_nsec - start->tv_nsec) / 1e6;
+}
+
+// Open a pidfd for the child; -1 if the kernel doesn't have pidfd_open (< 5.3)
+static int open_pidfd(pid_t pid) {
+#ifdef SYS_pidfd_open
+    return (int)syscall(SYS_pidfd_open, pid, 0);
+#else
+    (void)pid;
+    return -1;
+#endif
+}
+
+// ---------------- job parsing ----------------
+
+// Split s in place into words. Quotes group words and are removed.
+// Returns the word count, or -1 on an unterminated quote / too many words.
+static int split_words(char *s, char *argv[], int argc) {
+    char *out = s;
+
+    while (*s) {
+        while (*s == ' ' || *s == '\t') s++;
+        if (!*s) break;
+        if (argc >= MAX_ARGS) return -1;
+
+        argv[argc++] = out;
+        while (*s && *s != ' ' && *s != '\t') {
+            if (*s == '"' || *s == '\'') {
+                char q = *s++;
+                while (*s && *s != q) *out++ = *s++;
+                if (*s != q) return -1;
+                s++;
+            } else {
+                *out++ = *s++;
+            }
+        }
+        // s is at a separator or the end, so there is always room for the '\0'
+        if (*s) s++;
+        *out++ = '\0';
+    }
+
+    argv[argc] = NULL;
+    return argc;
+}
+
+static const char *skip_ws(const char *p) {
+    while (*p == ' ' || *p == '\t') p++;
+    return p;
+}
+
+// Decode a JSON string starting at the opening quote into *out (advanced).
+// Returns a pointer after the closing quote or NULL on bad input.
+// \uXXXX is only accepted for ASCII, which is all a command line needs here.
+static const char *json_string(const char *p, char **out) {
+    char *o = *out;
+
+    if (*p++ != '"') return NULL;
+    while (*p && *p != '"') {
+        if (*p != '\\') {
+            *o++ = *p++;
+            continue;
+        }
+        p++;
+        switch (*p) {
+        case '"': case '\\': case '/': *o++ = *p; break;
+        case 'n': *o++ = '\n'; break;
+        case 't': *o++ = '\t'; break;
+        case 'r': *o++ = '\r'; break;
+        case 'b': *o++ = '\b'; break;
+        case 'f': *o++ = '\f'; break;
+        case 'u': {
+            unsigned v = 0;
+            for (int k = 1; k <= 4; k++) {
+                char c = p[k];
+                v <<= 4;
+                if (c >= '0' && c <= '9') v |= (unsigned)(c - '0');
+                else if (c >= 'a' && c <= 'f') v |= (unsigned)(c - 'a' + 10);
+                else if (c >= 'A' && c <= 'F') v |= (unsigned)(c - 'A' + 10);
+                else return NULL;
+            }
+            if (v == 0 || v > 0x7f) return NULL;
+            *o++ = (char)v;
+            p += 4;
+            break;
+        }
+        default: return NULL;
+        }
+        p++;
+    }
+    if (*p != '"') return NULL;
+
+    *o++ = '\0';
+    *out = o;
+    return p + 1;
+}
+
+// Skip one JSON value we don't care about (other fields in the object).
+// Skipped strings are decoded into scratch, which is as long as the line.
+static const char *json_skip(const char *p, char *scratch) {
+    int depth = 0;
+
+    p = skip_ws(p);
+    if (*p != '"' && *p != '[' && *p != '{') {
+        // number, true, false, null
+        while (*p && *p != ',' && *p != '}' && *p != ']' && *p != ' ') p++;
+        return p;
+    }
+
+    // strings, arrays and objects: track nesting, stepping over strings whole
+    do {
+        if (*p == '"') {
+            char *s = scratch;
+            p = json_string(p, &s);
+            if (!p) return NULL;
+            continue;
+        }
+        if (*p == '[' || *p == '{') depth++;
+        else if (*p == ']' || *p == '}') depth--;
+        else if (!*p) return NULL;
+        p++;
+    } while (depth > 0);
+    return p;
+}
+
+// Parse {"cmd": [...]} or {"cmd": "..."}; other keys are ignored.
+// Strings are decoded into job->text, which is at least as long as the line.
+static int parse_json(const char *p, Job *job) {
+    char *o = job->text;
+    int found = 0;
+
+    p = skip_ws(p + 1);
+    while (*p && *p != '}') {
+        char *key = o;
+        p = json_string(p, &o);
+        if (!p) return -1;
+        p = skip_ws(p);
+        if (*p++ != ':') return -1;
+        p = skip_ws(p);
+
+        if (strcmp(key, "cmd") != 0) {
+            o = key;                        // drop the key text
+            p = json_skip(p, key);
+            if (!p) return -1;
+        } else if (*p == '[') {
+            o = key;
+            job->argc = 0;
+            p = skip_ws(p + 1);
+            while (*p == '"') {
+                if (job->argc >= MAX_ARGS) return -1;
+                job->argv[job->argc++] = o;
+                p = json_string(p, &o);
+                if (!p) return -1;
+                p = skip_ws(p);
+                if (*p == ',') p = skip_ws(p + 1);
+            }
+            if (*p++ != ']') return -1;
+            job->argv[job->argc] = NULL;
+            found = 1;
+        } else if (*p == '"') {
+            o = key;
+            char *str = o;
+            p = json_string(p, &o);
+            if (!p) return -1;
+            job->argc = split_words(str, job->argv, 0);
+            if (job->argc < 0) return -1;
+            found = 1;
+        } else {
+            return -1;
+        }
+
+        p = skip_ws(p);
+        if (*p == ',') p = skip_ws(p + 1);
+    }
+
+    if (*p != '}' || !found || job->argc == 0) return -1;
+    return 0;
+}
+
+// Read the next job from f. Returns 1 for a job, 0 at end of file.
+// Lines that don't parse are reported, counted and skipped.
+static int next_job(FILE *f, Job *job, long *lineNo) {
+    static char *line = NULL;
+    static size_t cap = 0;
+    ssize_t n;
+
+    while ((n = getline(&line, &cap, f)) >= 0) {
+        (*lineNo)++;
+        while (n > 0 && (line[n - 1] == '\n' || line[n - 1] == '\r')) line[--n] = '\0';
+
+        const char *p = skip_ws(line);
+        if (*p == '\0' || *p == '#') continue;
+
+        free(job->text);
+        job->text = malloc((size_t)n + 2);
+        if (!job->text) {
+            perror("malloc");
+            exit(1);
+        }
+        job->line = *lineNo;
+
+        int bad;
+        if (*p == '{') {
+            bad = parse_json(p, job) < 0;
+        } else {
+            strcpy(job->text, p);
+            job->argc = split_words(job->text, job->argv, 0);
+            bad = job->argc <= 0;
+        }
+
+        if (bad) {
+            fprintf(stderr, "line %ld: can't parse job, skipped: %s\n", *lineNo, line);
+            bad_job_count++;
+            continue;
+        }
+        return 1;
+    }
+    return 0;
+}
+
+// ---------------- running jobs ----------------
+
+// Fork one job into slot. The parent keeps going; the child never returns.
+static void start_job(Slot *slot, Job *job, long jobNo, int usePidfd) {
+    clock_gettime(CLOCK_MONOTONIC, &slot->start);
+    fflush(stdout);                 // don't let the child inherit buffered output
+    pid_t pid = fork();
+
+    if (pid < 0) {
+        perror("fork failed");
+        exit(1);
+    }
+    if (pid == 0) {
+        if (jobs_on_stdin) {
+            int fd = open("/dev/null", O_RDONLY);
+            if (fd > STDIN_FILENO) {
+                dup2(fd, STDIN_FILENO);
+                close(fd);
+            }
+        }
+        run_exec(job->argv);
+    }
+
+    slot->pid = pid;
+    slot->jobNo = jobNo;
+    slot->line = job->line;
+
+    // short name for the report: the words that fit
+    size_t used = 0;
+    slot->name[0] = '\0';
+    for (int k = 0; k < job->argc; k++) {
+        int w = snprintf(slot->name + used, sizeof(slot->name) - used, "%s%s",
+                         k ? " " : "", job->argv[k]);
+        if (w < 0 || used + (size_t)w >= sizeof(slot->name)) break;
+        used += (size_t)w;
+    }
+
+    // the caller registers the pidfd with epoll under the slot number
+    slot->pidfd = usePidfd ? open_pidfd(pid) : -1;
+}
+
+// Report one finished job and count it
+static void report_job(Slot *slot, long rank, int status) {
+    double ms = ms_since(&slot->start);
+
+    if (WIFEXITED(status)) {
+        int code = WEXITSTATUS(status);
+        if (code == 0) exit0_count++;
+        else exit_nonzero_count++;
+
+        if (!quiet || code != 0)
+            printf("#%-4ld job %ld (line %ld, PID=%d) EXITED normally | code=%d | %.2f ms | %s\n",
+                   rank, slot->jobNo, slot->line, (int)slot->pid, code, ms, slot->name);
+    } else if (WIFSIGNALED(status)) {
+        signal_term_count++;
+        printf("#%-4ld job %ld (line %ld, PID=%d) TERMINATED by signal | signal=%d | %.2f ms | %s\n",
+               rank, slot->jobNo, slot->line, (int)slot->pid, WTERMSIG(status), ms, slot->name);
+    }
+
+    slot->pid = 0;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-j N] [-q] [jobfile]\n", prog);
+}
+
+int main(int argc, char *argv[]) {
+    int maxJobs = 4;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "j:qh")) != -1) {
+        switch (opt) {
+        case 'j': maxJobs = atoi(optarg); break;
+        case 'q': quiet = 1; break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (maxJobs < 1 || maxJobs > MAX_SLOTS || optind + 1 < argc) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    FILE *f = stdin;
+    if (optind < argc && strcmp(argv[optind], "-") != 0) {
+        f = fopen(argv[optind], "re");
+        if (!f) {
+            perror(argv[optind]);
+            return 1;
+        }
+    }
+    jobs_on_stdin = f == stdin;
+
+    Slot *slots = calloc((size_t)maxJobs, sizeof(Slot));
+    struct epoll_event *ready = malloc(sizeof(struct epoll_event) * (size_t)maxJobs);
+    if (!slots || !ready) {
+        perror("malloc");
+        return 1;
+    }
+
+    // pidfds let us wait on exactly our children; without them (or if any
+    // pidfd_open fails) we fall back to waitpid(-1) for the rest of the run
+    int ep = epoll_create1(EPOLL_CLOEXEC);
+    int usePidfd = ep >= 0;
+
+    printf("Launcher PID: %d | at most %d jobs at once\n\n", (int)getpid(), maxJobs);
+
+    struct timespec runStart;
+    clock_gettime(CLOCK_MONOTONIC, &runStart);
+
+    Job job = {0};
+    long lineNo = 0, launched = 0, reaped = 0;
+    int running = 0, more = 1;
+
+    while (more || running > 0) {
+        // fill every free slot
+        for (int s = 0; s < maxJobs && more; s++) {
+            if (slots[s].pid != 0) continue;
+            more = next_job(f, &job, &lineNo);
+            if (!more) break;
+
+            start_job(&slots[s], &job, ++launched, usePidfd);
+            running++;
+
+            if (usePidfd && slots[s].pidfd < 0) {
+                usePidfd = 0;       // e.g. kernel < 5.3
+            } else if (usePidfd) {
+                struct epoll_event ev = {0};
+                ev.events = EPOLLIN;
+                ev.data.u32 = (unsigned)s;
+                if (epoll_ctl(ep, EPOLL_CTL_ADD, slots[s].pidfd, &ev) < 0) {
+                    perror("epoll_ctl failed");
+                    exit(1);
+                }
+            }
+        }
+        if (running == 0) break;
+
+        if (usePidfd) {
+            int n = epoll_wait(ep, ready, maxJobs, -1);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                perror("epoll_wait failed");
+                exit(1);
+            }
+
+            for (int k = 0; k < n; k++) {
+                Slot *slot = &slots[ready[k].data.u32];
+                int status;
+
+                // The child is a zombie now, so this returns right away
+                if (waitpid(slot->pid, &status, 0) < 0) {
+                    perror("waitpid failed");
+                    exit(1);
+                }
+                epoll_ctl(ep, EPOLL_CTL_DEL, slot->pidfd, NULL);
+                close(slot->pidfd);
+                report_job(slot, ++reaped, status);
+                running--;
+            }
+        } else {
+            int status;
+            pid_t pid = waitpid(-1, &status, 0);
+            if (pid < 0) {
+                if (errno == EINTR) continue;
+                perror("waitpid failed");
+                exit(1);
+            }
+
+            for (int s = 0; s < maxJobs; s++) {
+                if (slots[s].pid != pid) continue;
+                if (slots[s].pidfd >= 0) {
+                    // started while pidfds still worked
+                    epoll_ctl(ep, EPOLL_CTL_DEL, slots[s].pidfd, NULL);
+                    close(slots[s].pidfd);
+                }
+                report_job(&slots[s], ++reaped, status);
+                running--;
+                break;
+            }
+        }
+    }
+
+    double wallMs = ms_since(&runStart);
+
+    // Print summary counts
+    printf("\n--- Summary ---\n");
+    printf("Jobs run: %ld in %.1f ms (%.1f jobs/s, at most %d at once)\n",
+           launched, wallMs, wallMs > 0 ? launched / (wallMs / 1e3) : 0.0, maxJobs);
+    printf("Exit normally with code 0: %ld\n", exit0_count);
+    printf("Exit normally with non-zero code: %ld\n", exit_nonzero_count);
+    printf("Terminated by signal: %ld\n", signal_term_count);
+    if (bad_job_count) printf("Lines skipped (could not parse): %ld\n", bad_job_count);
+
+    if (ep >= 0) close(ep);
+    if (f != stdin) fclose(f);
+    free(job.text);
+    free(ready);
+    free(slots);
+
+    return exit_nonzero_count || signal_term_count || bad_job_count ? 1 : 0;
+}
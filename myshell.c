@@ -1,131 +1,2048 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/sendfile.h>
+#include <sys/syscall.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <dirent.h>
+#include <limits.h>
+#include <time.h>
+#include <signal.h>
+#include <sched.h>
+#include <linux/capability.h>
+
+#define MAX_LINE 1024
+#define MAX_ARGS 128
+#define MAX_REDIRS 16
+#define MAX_COPROCS 8
+
+// glob directory cache: listings are reused for a short time so repeated
+// patterns over big directories don't re-read them on every command
+#define GLOB_CACHE_SLOTS 32
+#define GLOB_CACHE_TTL_MS 2000
+#define GETDENTS_BUF (256 * 1024)
+
+// chunk size for the cat/tee built-ins (below the default 64 KiB pipe size)
+#define COPY_CHUNK (32 * 1024)
+
+// remove trailing newline
+static void trim_newline(char *s) {
+    s[strcspn(s, "\n")] = 0;
+}
+
+// ---------------- shell variables ----------------
+
+// one variable in the open-addressing table (linear probing)
+typedef struct {
+    char *name;     // NULL for an empty or deleted slot
+    char *value;
+    char *envstr;   // "name=value", handed to environ without copying
+    int exported;
+    int deleted;    // tombstone, keeps probe chains intact after unset
+} Var;
+
+static Var *g_vars = NULL;
+static size_t g_vars_cap = 0;       // power of two
+static size_t g_vars_used = 0;      // live entries plus tombstones
+
+// environ is rebuilt from the table only when an exported var changed
+static char **g_env = NULL;
+static size_t g_env_cap = 0;
+static int g_env_dirty = 1;
+
+// status of the last command, for $?
+static int g_last_status = 0;
+
+extern char **environ;
+
+static size_t var_hash(const char *s, size_t n) {
+    // FNV-1a
+    uint64_t h = 1469598103934665603ULL;
+    for (size_t i = 0; i < n; i++) {
+        h ^= (unsigned char)s[i];
+        h *= 1099511628211ULL;
+    }
+    return (size_t)h;
+}
+
+static int is_name_char(char c, int first) {
+    if ((c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || c == '_') return 1;
+    return !first && c >= '0' && c <= '9';
+}
+
+// find the slot for name[0..n); with create, returns a free slot to fill
+static Var *var_slot(const char *name, size_t n, int create) {
+    if (g_vars_cap == 0) return NULL;
+
+    size_t mask = g_vars_cap - 1;
+    size_t i = var_hash(name, n) & mask;
+    Var *tomb = NULL;
+
+    for (;;) {
+        Var *v = &g_vars[i];
+        if (!v->name) {
+            if (!v->deleted) return create ? (tomb ? tomb : v) : NULL;
+            if (!tomb) tomb = v;
+        } else if (strncmp(v->name, name, n) == 0 && v->name[n] == '\0') {
+            return v;
+        }
+        i = (i + 1) & mask;
+    }
+}
+
+static int var_grow(void) {
+    size_t ncap = g_vars_cap ? g_vars_cap * 2 : 256;
+    Var *old = g_vars;
+    size_t ocap = g_vars_cap;
+
+    g_vars = calloc(ncap, sizeof(Var));
+    if (!g_vars) {
+        g_vars = old;
+        return -1;
+    }
+    g_vars_cap = ncap;
+    g_vars_used = 0;
+
+    // rehash live entries, dropping tombstones
+    for (size_t i = 0; i < ocap; i++) {
+        if (!old[i].name) continue;
+        *var_slot(old[i].name, strlen(old[i].name), 1) = old[i];
+        g_vars_used++;
+    }
+    free(old);
+    return 0;
+}
+
+static const char *var_get(const char *name) {
+    Var *v = var_slot(name, strlen(name), 0);
+    return v ? v->value : NULL;
+}
+
+// set name=value; export: 1 exports, 0 keeps the current export flag
+static int var_set(const char *name, const char *value, int export) {
+    size_t n = strlen(name);
+    Var *v = var_slot(name, n, 0);
+
+    if (!v) {
+        if ((g_vars_used + 1) * 4 > g_vars_cap * 3 && var_grow() != 0) return -1;
+        v = var_slot(name, n, 1);
+        if (!v->deleted) g_vars_used++;
+        v->deleted = 0;
+        v->exported = 0;
+        v->value = NULL;
+        v->envstr = NULL;
+        v->name = strdup(name);
+        if (!v->name) return -1;
+    }
+
+    if (value) {
+        size_t vn = strlen(value);
+        char *envstr = malloc(n + vn + 2);
+        if (!envstr) return -1;
+        memcpy(envstr, name, n);
+        envstr[n] = '=';
+        memcpy(envstr + n + 1, value, vn + 1);
+
+        free(v->envstr);
+        v->envstr = envstr;
+        v->value = envstr + n + 1;
+    }
+
+    if (export) v->exported = 1;
+    if (v->exported && v->value) g_env_dirty = 1;
+    return 0;
+}
+
+static void var_unset(const char *name) {
+    Var *v = var_slot(name, strlen(name), 0);
+    if (!v) return;
+    if (v->exported) g_env_dirty = 1;
+    free(v->name);
+    free(v->envstr);
+    memset(v, 0, sizeof(*v));
+    v->deleted = 1;
+}
+
+// point environ at the exported variables if anything changed since last time
+static void env_sync(void) {
+    if (!g_env_dirty) return;
+
+    size_t n = 0;
+    for (size_t i = 0; i < g_vars_cap; i++) {
+        if (g_vars[i].name && g_vars[i].exported && g_vars[i].envstr) n++;
+    }
+    if (n + 1 > g_env_cap) {
+        char **ne = realloc(g_env, (n + 1) * sizeof(char *));
+        if (!ne) return;
+        g_env = ne;
+        g_env_cap = n + 1;
+    }
+
+    n = 0;
+    for (size_t i = 0; i < g_vars_cap; i++) {
+        if (g_vars[i].name && g_vars[i].exported && g_vars[i].envstr) g_env[n++] = g_vars[i].envstr;
+    }
+    g_env[n] = NULL;
+
+    environ = g_env;
+    g_env_dirty = 0;
+}
+
+// load the inherited environment as exported variables
+static void vars_init(void) {
+    var_grow();
+    for (char **e = environ; e && *e; e++) {
+        char *eq = strchr(*e, '=');
+        if (!eq || eq == *e) continue;
+        char *name = strndup(*e, eq - *e);
+        if (!name) continue;
+        var_set(name, eq + 1, 1);
+        free(name);
+    }
+}
+
+// "NAME=value" with a valid name?
+static int is_assignment(const char *w) {
+    if (!is_name_char(w[0], 1)) return 0;
+    const char *p = w + 1;
+    while (is_name_char(*p, 0)) p++;
+    return *p == '=';
+}
+
+// assign a NAME=value word to a shell variable
+static void assign_word(const char *w) {
+    const char *eq = strchr(w, '=');
+    char *name = strndup(w, eq - w);
+    if (!name) return;
+    var_set(name, eq + 1, 0);
+    free(name);
+}
+
+// append s to out[*k], keeping room for the terminator
+static void put_str(char *out, int *k, const char *s) {
+    while (*s && *k < MAX_LINE - 2) out[(*k)++] = *s++;
+}
+
+// expand $NAME, ${NAME}, ${NAME:-word}, ${NAME-word}, $? and $$ at line[*i]
+// into out. Anything else after $ is kept literally.
+static void expand_param(const char *line, int len, int *i, char *out, int *k) {
+    char name[MAX_LINE];
+    char num[32];
+    const char *val = NULL;
+    int p = *i + 1;
+    int n = 0;
+
+    if (p < len && (line[p] == '?' || line[p] == '$')) {
+        snprintf(num, sizeof(num), "%d", line[p] == '?' ? g_last_status : (int)getpid());
+        put_str(out, k, num);
+        *i = p + 1;
+        return;
+    }
+
+    if (p < len && line[p] != '{') {
+        while (p < len && is_name_char(line[p], n == 0)) name[n++] = line[p++];
+        name[n] = '\0';
+        if (n == 0) {
+            put_str(out, k, "$");
+            (*i)++;
+            return;
+        }
+        val = var_get(name);
+        if (val) put_str(out, k, val);
+        *i = p;
+        return;
+    }
+
+    // ${...}
+    p++;
+    while (p < len && is_name_char(line[p], n == 0)) name[n++] = line[p++];
+    name[n] = '\0';
+
+    if (n > 0 && p < len && line[p] == '}') {
+        val = var_get(name);
+        if (val) put_str(out, k, val);
+        *i = p + 1;
+        return;
+    }
+
+    int colon = (p < len && line[p] == ':');
+    if (n == 0 || p + colon >= len || line[p + colon] != '-') {
+        put_str(out, k, "$");
+        (*i)++;
+        return;
+    }
+
+    // find the closing brace of the default word, allowing nested ${}
+    int start = p + colon + 1;
+    int end = start;
+    int depth = 1;
+    while (end < len) {
+        if (line[end] == '{') depth++;
+        else if (line[end] == '}' && --depth == 0) break;
+        end++;
+    }
+    if (end >= len) {
+        put_str(out, k, "$");
+        (*i)++;
+        return;
+    }
+
+    val = var_get(name);
+    if (val && !(colon && val[0] == '\0')) {
+        put_str(out, k, val);
+    } else {
+        // the default word is itself expanded
+        for (int j = start; j < end;) {
+            if (line[j] == '$') {
+                expand_param(line, end, &j, out, k);
+            } else if (line[j] == '"') {
+                j++;
+            } else {
+                if (*k < MAX_LINE - 2) out[(*k)++] = line[j];
+                j++;
+            }
+        }
+    }
+    *i = end + 1;
+}
+
+// redirection kinds, applied left to right in the child
+enum {
+    REDIR_IN,       // n<file
+    REDIR_OUT,      // n>file
+    REDIR_APPEND,   // n>>file
+    REDIR_RDWR,     // n<>file
+    REDIR_DUP,      // n>&m, n<&m
+    REDIR_CLOSE,    // n>&-, n<&-
+    REDIR_HERESTR,  // n<<<word
+    REDIR_HEREDOC,  // n<<DELIM, body read from the following lines
+    REDIR_ENV       // NAME=value in front of a command, child environment only
+};
+
+typedef struct {
+    int type;
+    int fd;         // fd in the child being redirected
+    int src_fd;     // REDIR_DUP source
+    char *arg;      // file name, here-string text, here-doc delimiter/body, or NAME=value
+} Redir;
+
+// free malloc'd args, the argv vector and redirection strings
+static void cleanup(char **argv, int argc, Redir *redirs, int nredir) {
+    for (int i = 0; i < argc; i++) {
+        free(argv[i]);
+    }
+    free(argv);
+    for (int i = 0; i < nredir; i++) {
+        free(redirs[i].arg);
+    }
+}
+
+// append c to a glob pattern, backslash-escaping it when it came from
+// quotes or a \ escape so it only matches itself
+static void pat_put(char *pat, int *pk, char c, int literal) {
+    if (*pk >= MAX_LINE * 2 - 3) return;
+    if (literal && strchr("*?[]\\", c)) pat[(*pk)++] = '\\';
+    pat[(*pk)++] = c;
+}
+
+// read one word starting at line[*i] into a malloc'd string, expanding $
+// parameters. "..." (expanded) and '...' (literal) sections may appear
+// anywhere in the word, and \ escapes the next character outside '...'.
+// Unquoted, the word stops at whitespace and at < or >.
+// If pattern is given it receives a glob pattern for the word, with the
+// quoted and escaped characters escaped, or NULL when no unquoted *, ? or [
+// is left to expand.
+static char *read_word(const char *line, int len, int *i, int *was_quoted, char **pattern) {
+    char *word = malloc(MAX_LINE);
+    char *pat = pattern ? malloc(MAX_LINE * 2) : NULL;
+    if (!word || (pattern && !pat)) {
+        free(word);
+        free(pat);
+        return NULL;
+    }
+
+    int k = 0, pk = 0;
+    int in_quotes = 0, q = 0, globs = 0;
+    while (*i < len) {
+        char c = line[*i];
+        if (c == '"') {
+            in_quotes = !in_quotes;
+            q = 1;
+            (*i)++;
+            continue;
+        }
+        if (c == '\'' && !in_quotes) {
+            q = 1;
+            (*i)++;
+            while (*i < len && line[*i] != '\'') {
+                if (k < MAX_LINE - 2) word[k++] = line[*i];
+                if (pat) pat_put(pat, &pk, line[*i], 1);
+                (*i)++;
+            }
+            if (*i < len) (*i)++;
+            continue;
+        }
+        if (c == '\\' && *i + 1 < len) {
+            if (k < MAX_LINE - 2) word[k++] = line[*i + 1];
+            if (pat) pat_put(pat, &pk, line[*i + 1], 1);
+            *i += 2;
+            continue;
+        }
+        if (!in_quotes && (c == ' ' || c == '\t' || c == '<' || c == '>')) break;
+        if (c == '$') {
+            // unquoted expansions still glob, like in sh
+            int k0 = k;
+            expand_param(line, len, i, word, &k);
+            for (int e = k0; pat && e < k; e++) {
+                if (!in_quotes && strchr("*?[", word[e])) globs = 1;
+                pat_put(pat, &pk, word[e], in_quotes || word[e] == '\\');
+            }
+            continue;
+        }
+        if (k < MAX_LINE - 2) word[k++] = c;
+        if (pat) {
+            if (!in_quotes && strchr("*?[", c)) globs = 1;
+            pat_put(pat, &pk, c, in_quotes);
+        }
+        (*i)++;
+    }
+    word[k] = '\0';
+    if (was_quoted) *was_quoted = q;
+    if (pattern) {
+        pat[pk] = '\0';
+        if (!globs) {
+            free(pat);
+            pat = NULL;
+        }
+        *pattern = pat;
+    }
+    return word;
+}
+
+// parse a redirection operator at line[*i] (after any fd number) into r.
+// fd is the explicit fd prefix or -1. Returns 0 or -1 on a syntax error.
+static int parse_redir(const char *line, int len, int *i, int fd, Redir *r) {
+    int both = 0;   // &> and >& file send stdout and stderr together
+
+    r->arg = NULL;
+    r->src_fd = -1;
+
+    if (line[*i] == '&') {
+        if (fd >= 0) return -1;
+        both = 1;
+        (*i)++;
+    }
+
+    if (line[*i] == '<') {
+        if (both) return -1;
+        (*i)++;
+        r->fd = (fd >= 0) ? fd : STDIN_FILENO;
+        r->type = REDIR_IN;
+        if (*i + 1 < len && line[*i] == '<' && line[*i + 1] == '<') {
+            r->type = REDIR_HERESTR;
+            *i += 2;
+        } else if (*i < len && line[*i] == '<') {
+            r->type = REDIR_HEREDOC;
+            (*i)++;
+        } else if (*i < len && line[*i] == '>') {
+            r->type = REDIR_RDWR;
+            (*i)++;
+        } else if (*i < len && line[*i] == '&') {
+            r->type = REDIR_DUP;
+            (*i)++;
+        }
+    } else {
+        (*i)++;
+        r->fd = (fd >= 0) ? fd : STDOUT_FILENO;
+        r->type = REDIR_OUT;
+        if (*i < len && line[*i] == '>') {
+            r->type = REDIR_APPEND;
+            (*i)++;
+        } else if (*i < len && line[*i] == '&' && !both) {
+            r->type = REDIR_DUP;
+            (*i)++;
+        }
+    }
+
+    while (*i < len && (line[*i] == ' ' || line[*i] == '\t')) (*i)++;
+    if (*i >= len) return -1;
+
+    r->arg = read_word(line, len, i, NULL, NULL);
+    if (!r->arg) return -1;
+
+    if (r->type == REDIR_DUP) {
+        const char *t = r->arg;
+        if (strcmp(t, "-") == 0) {
+            r->type = REDIR_CLOSE;
+        } else if (t[0] && strspn(t, "0123456789") == strlen(t)) {
+            r->src_fd = atoi(t);
+        } else if (fd < 0 && r->fd == STDOUT_FILENO) {
+            // ">&file" with no fd is the same as "&>file"
+            r->type = REDIR_OUT;
+            both = 1;
+        } else {
+            free(r->arg);
+            r->arg = NULL;
+            return -1;
+        }
+        if (r->type != REDIR_OUT) {
+            free(r->arg);
+            r->arg = NULL;
+            return 0;
+        }
+    }
+
+    if (r->type == REDIR_HERESTR) {
+        // here-strings get a trailing newline like in sh
+        size_t n = strlen(r->arg);
+        r->arg[n] = '\n';
+        r->arg[n + 1] = '\0';
+    }
+
+    if (both) r->fd = -1;   // marks "stdout and stderr"
+    return 0;
+}
+
+// parse input line into argv and redirections (<, >, >>, <>, n>&m, n>&-,
+// &>, <<<, <<); leading NAME=value words go into redirs as REDIR_ENV.
+// pats[i] is the glob pattern for argv[i], or NULL when nothing in it is
+// left to expand. Returns argc, or -1 on a syntax error.
+static int parse_line(const char *line, char *argv[], char *pats[], int max_args,
+                      Redir redirs[], int *nredir) {
+    int argc = 0;
+    int i = 0;
+    int len = (int)strlen(line);
+
+    *nredir = 0;
+
+    while (i < len) {
+        // skip spaces/tabs
+        while (i < len && (line[i] == ' ' || line[i] == '\t')) i++;
+        if (i >= len) break;
+
+        // optional fd number directly in front of < or >
+        int j = i;
+        int fd = -1;
+        while (j < len && line[j] >= '0' && line[j] <= '9') j++;
+        if (j > i && j < len && (line[j] == '<' || line[j] == '>')) {
+            fd = atoi(line + i);
+            i = j;
+        }
+
+        if (line[i] == '<' || line[i] == '>' ||
+            (line[i] == '&' && i + 1 < len && line[i + 1] == '>')) {
+            if (*nredir >= MAX_REDIRS ||
+                parse_redir(line, len, &i, fd, &redirs[*nredir]) != 0) {
+                cleanup(NULL, 0, redirs, *nredir);
+                for (int a = 0; a < argc; a++) { free(argv[a]); free(pats[a]); }
+                *nredir = 0;
+                return -1;
+            }
+            (*nredir)++;
+            continue;
+        }
+
+        // normal argument (quoted or not)
+        if (argc >= max_args - 1) break;
+
+        // decide on the raw text: "A=b" or a $X holding A=b is a command
+        int assignment = (argc == 0 && is_assignment(line + i));
+        int quoted;
+        char *pat;
+        char *arg = read_word(line, len, &i, &quoted, &pat);
+        if (!arg) {
+            cleanup(NULL, 0, redirs, *nredir);
+            for (int a = 0; a < argc; a++) { free(argv[a]); free(pats[a]); }
+            *nredir = 0;
+            return -1;
+        }
+
+        // unquoted words that expanded to nothing disappear
+        if (arg[0] == '\0' && !quoted) {
+            free(arg);
+            free(pat);
+            continue;
+        }
+
+        // NAME=value before the command word is an assignment, not an arg
+        if (assignment) {
+            free(pat);
+            if (*nredir >= MAX_REDIRS) {
+                free(arg);
+                cleanup(NULL, 0, redirs, *nredir);
+                *nredir = 0;
+                return -1;
+            }
+            redirs[*nredir].type = REDIR_ENV;
+            redirs[*nredir].fd = -1;
+            redirs[*nredir].src_fd = -1;
+            redirs[*nredir].arg = arg;
+            (*nredir)++;
+            continue;
+        }
+
+        pats[argc] = pat;
+        argv[argc++] = arg;
+    }
+
+    argv[argc] = NULL;
+    return argc;
+}
+
+// here-docs: replace each delimiter with the body read from the next input
+// lines, up to a line holding only the delimiter
+static int read_heredocs(Redir redirs[], int nredir, FILE *in) {
+    char line[MAX_LINE];
+
+    for (int r = 0; r < nredir; r++) {
+        if (redirs[r].type != REDIR_HEREDOC) continue;
+
+        size_t cap = 256, used = 0;
+        char *body = malloc(cap);
+        if (!body) return -1;
+        body[0] = '\0';
+
+        for (;;) {
+            if (isatty(STDIN_FILENO)) {
+                printf("> ");
+                fflush(stdout);
+            }
+            if (!fgets(line, sizeof(line), in)) break;
+            trim_newline(line);
+            if (strcmp(line, redirs[r].arg) == 0) break;
+
+            size_t n = strlen(line);
+            if (used + n + 2 > cap) {
+                while (used + n + 2 > cap) cap *= 2;
+                char *nb = realloc(body, cap);
+                if (!nb) { free(body); return -1; }
+                body = nb;
+            }
+            memcpy(body + used, line, n);
+            body[used + n] = '\n';
+            used += n + 1;
+            body[used] = '\0';
+        }
+
+        free(redirs[r].arg);
+        redirs[r].arg = body;
+    }
+    return 0;
+}
+
+// put a here-string/here-doc body on fd: a memfd holds any size without a
+// reader; plain pipes are the fallback on kernels without memfd_create
+static int feed_text(int fd, const char *text) {
+    size_t n = strlen(text);
+    int tfd = memfd_create("myshell-heredoc", 0);
+
+    if (tfd >= 0) {
+        if (write(tfd, text, n) != (ssize_t)n || lseek(tfd, 0, SEEK_SET) < 0) {
+            close(tfd);
+            return -1;
+        }
+    } else {
+        int p[2];
+        if (pipe(p) != 0) return -1;
+        // the child fills its own pipe before exec, so the body must fit;
+        // a failed resize (-1) must not pass as a huge pipe
+        int cap = n > INT_MAX ? -1 : fcntl(p[1], F_SETPIPE_SZ, (int)n);
+        if (cap < 0 || n > (size_t)cap || write(p[1], text, n) != (ssize_t)n) {
+            close(p[0]);
+            close(p[1]);
+            errno = EFBIG;
+            return -1;
+        }
+        close(p[1]);
+        tfd = p[0];
+    }
+
+    if (tfd != fd) {
+        if (dup2(tfd, fd) < 0) { close(tfd); return -1; }
+        close(tfd);
+    }
+    return 0;
+}
+
+// apply redirections in order. NAME=value entries only go into the
+// environment in_child, built-ins run in the shell skip them.
+// Returns 0 or -1 with a message.
+static int apply_redirs(const Redir redirs[], int nredir, int in_child) {
+    for (int r = 0; r < nredir; r++) {
+        const Redir *rd = &redirs[r];
+        int flags = 0;
+
+        switch (rd->type) {
+        case REDIR_CLOSE:
+            close(rd->fd);
+            continue;
+
+        case REDIR_DUP:
+            if (dup2(rd->src_fd, rd->fd) < 0) {
+                fprintf(stderr, "redirect: %d: %s\n", rd->src_fd, strerror(errno));
+                return -1;
+            }
+            continue;
+
+        case REDIR_ENV:
+            if (in_child) putenv(rd->arg);
+            continue;
+
+        case REDIR_HERESTR:
+        case REDIR_HEREDOC:
+            if (feed_text(rd->fd, rd->arg) != 0) {
+                fprintf(stderr, "here-document: %s\n", strerror(errno));
+                return -1;
+            }
+            continue;
+
+        case REDIR_IN:     flags = O_RDONLY; break;
+        case REDIR_RDWR:   flags = O_RDWR | O_CREAT; break;
+        case REDIR_OUT:    flags = O_WRONLY | O_CREAT | O_TRUNC; break;
+        case REDIR_APPEND: flags = O_WRONLY | O_CREAT | O_APPEND; break;
+        }
+
+        int fd = open(rd->arg, flags, 0644);
+        if (fd < 0) {
+            fprintf(stderr, "%s redirect: %s: %s\n",
+                    rd->type == REDIR_IN ? "input" : "output", rd->arg, strerror(errno));
+            return -1;
+        }
+
+        // fd == -1 means &> (stdout and stderr)
+        int target = (rd->fd < 0) ? STDOUT_FILENO : rd->fd;
+        if (fd != target) {
+            dup2(fd, target);
+            close(fd);
+        }
+        if (rd->fd < 0) dup2(STDOUT_FILENO, STDERR_FILENO);
+    }
+    return 0;
+}
+
+// ---------------- glob expansion ----------------
+
+// record layout returned by getdents64
+struct linux_dirent64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+// one cached directory listing, names packed into a single buffer
+typedef struct {
+    int used;
+    int pinned;             // >0 while a walk is iterating this listing
+    dev_t dev;
+    ino_t ino;
+    struct timespec mtime;  // directory mtime when it was read
+    long long loaded_ms;
+    long long last_use;
+    char *names;            // NUL-terminated names back to back
+    size_t names_len, names_cap;
+    size_t *offs;           // offset of each name inside names
+    unsigned char *types;   // d_type of each name
+    int count, cap;
+} DirCache;
+
+// growable vector of malloc'd strings
+typedef struct {
+    char **v;
+    int n, cap;
+} StrVec;
+
+static DirCache g_dircache[GLOB_CACHE_SLOTS];
+static char *g_dents_buf = NULL;
+
+static long long now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static int strvec_push(StrVec *sv, char *s) {
+    if (!s) return -1;
+    if (sv->n + 1 >= sv->cap) {
+        int ncap = sv->cap ? sv->cap * 2 : 64;
+        char **nv = realloc(sv->v, ncap * sizeof(char *));
+        if (!nv) { free(s); return -1; }
+        sv->v = nv;
+        sv->cap = ncap;
+    }
+    sv->v[sv->n++] = s;
+    sv->v[sv->n] = NULL;
+    return 0;
+}
+
+static void dircache_reset(DirCache *dc) {
+    free(dc->names);
+    free(dc->offs);
+    free(dc->types);
+    memset(dc, 0, sizeof(*dc));
+}
+
+static int dircache_add(DirCache *dc, const char *name, unsigned char type) {
+    size_t n = strlen(name) + 1;
+
+    if (dc->names_len + n > dc->names_cap) {
+        size_t ncap = dc->names_cap ? dc->names_cap * 2 : 4096;
+        while (ncap < dc->names_len + n) ncap *= 2;
+        char *nn = realloc(dc->names, ncap);
+        if (!nn) return -1;
+        dc->names = nn;
+        dc->names_cap = ncap;
+    }
+    if (dc->count >= dc->cap) {
+        int ncap = dc->cap ? dc->cap * 2 : 256;
+        size_t *no = realloc(dc->offs, ncap * sizeof(size_t));
+        if (!no) return -1;
+        dc->offs = no;
+        unsigned char *nt = realloc(dc->types, ncap);
+        if (!nt) return -1;
+        dc->types = nt;
+        dc->cap = ncap;
+    }
+
+    memcpy(dc->names + dc->names_len, name, n);
+    dc->offs[dc->count] = dc->names_len;
+    dc->types[dc->count] = type;
+    dc->names_len += n;
+    dc->count++;
+    return 0;
+}
+
+// read a whole directory with raw getdents64 calls into a big buffer
+static int dircache_load(DirCache *dc, const char *path) {
+    if (!g_dents_buf) {
+        g_dents_buf = malloc(GETDENTS_BUF);
+        if (!g_dents_buf) return -1;
+    }
+
+    int fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) return -1;
+
+    for (;;) {
+        long nread = syscall(SYS_getdents64, fd, g_dents_buf, GETDENTS_BUF);
+        if (nread < 0) { close(fd); return -1; }
+        if (nread == 0) break;
+
+        for (long pos = 0; pos < nread;) {
+            struct linux_dirent64 *d = (struct linux_dirent64 *)(g_dents_buf + pos);
+            pos += d->d_reclen;
+
+            if (strcmp(d->d_name, ".") == 0 || strcmp(d->d_name, "..") == 0) continue;
+            if (dircache_add(dc, d->d_name, d->d_type) != 0) { close(fd); return -1; }
+        }
+    }
+
+    close(fd);
+    return 0;
+}
+
+// get the listing for a directory, from cache if it is fresh and unchanged.
+// The result is pinned until dircache_put so nested walks can't evict it.
+static DirCache *dircache_get(const char *path) {
+    struct stat st;
+    if (stat(path, &st) != 0 || !S_ISDIR(st.st_mode)) return NULL;
+
+    long long now = now_ms();
+    DirCache *victim = NULL;
+
+    for (int i = 0; i < GLOB_CACHE_SLOTS; i++) {
+        DirCache *dc = &g_dircache[i];
+        if (dc->used && dc->dev == st.st_dev && dc->ino == st.st_ino) {
+            if (now - dc->loaded_ms <= GLOB_CACHE_TTL_MS &&
+                dc->mtime.tv_sec == st.st_mtim.tv_sec &&
+                dc->mtime.tv_nsec == st.st_mtim.tv_nsec) {
+                dc->last_use = now;
+                dc->pinned++;
+                return dc;
+            }
+            // stale listing: reload into the same slot unless a walk is using it
+            if (!dc->pinned) {
+                victim = dc;
+                break;
+            }
+        }
+    }
+
+    if (!victim) {
+        for (int i = 0; i < GLOB_CACHE_SLOTS; i++) {
+            DirCache *dc = &g_dircache[i];
+            if (dc->pinned) continue;
+            if (!dc->used) { victim = dc; break; }
+            if (!victim || dc->last_use < victim->last_use) victim = dc;
+        }
+    }
+
+    // every slot is pinned by a deep ** walk: use an uncached listing
+    int temp = 0;
+    if (!victim) {
+        victim = calloc(1, sizeof(DirCache));
+        if (!victim) return NULL;
+        temp = 1;
+    }
+
+    dircache_reset(victim);
+    if (dircache_load(victim, path) != 0) {
+        dircache_reset(victim);
+        if (temp) free(victim);
+        return NULL;
+    }
+
+    victim->used = temp ? -1 : 1;
+    victim->dev = st.st_dev;
+    victim->ino = st.st_ino;
+    victim->mtime = st.st_mtim;
+    victim->loaded_ms = now;
+    victim->last_use = now;
+    victim->pinned = 1;
+    return victim;
+}
+
+static void dircache_put(DirCache *dc) {
+    if (dc->used < 0) {
+        dircache_reset(dc);
+        free(dc);
+        return;
+    }
+    dc->pinned--;
+}
+
+// any *, ? or [ not escaped with a backslash?
+static int has_glob(const char *s) {
+    for (; *s; s++) {
+        if (*s == '\\' && s[1]) s++;
+        else if (*s == '*' || *s == '?' || *s == '[') return 1;
+    }
+    return 0;
+}
+
+// copy a pattern component without its backslash escapes
+static void glob_unescape(char *dst, const char *src) {
+    for (; *src; src++) {
+        if (*src == '\\' && src[1]) src++;
+        *dst++ = *src;
+    }
+    *dst = '\0';
+}
+
+// match c against a [...] class starting at p; sets *next past the ']'.
+// Returns 1/0 for match/no match, -1 if the class is not terminated.
+static int class_match(const char *p, unsigned char c, const char **next) {
+    const char *q = p + 1;
+    int negate = 0, matched = 0;
+
+    if (*q == '!' || *q == '^') { negate = 1; q++; }
+
+    // a ']' right after the opening bracket is a literal
+    if (*q == ']') { matched |= (c == ']'); q++; }
+
+    while (*q && *q != ']') {
+        // \x inside a class is a literal x
+        if (*q == '\\' && q[1]) q++;
+        unsigned char lo = (unsigned char)*q;
+        if (q[1] == '-' && q[2] && q[2] != ']') {
+            if (q[2] == '\\' && q[3]) q++;
+            unsigned char hi = (unsigned char)q[2];
+            if (lo <= c && c <= hi) matched = 1;
+            q += 3;
+        } else {
+            if (lo == c) matched = 1;
+            q++;
+        }
+    }
+    if (*q != ']') return -1;
+
+    *next = q + 1;
+    return matched ^ negate;
+}
+
+// match one path component against a pattern using *, ? and [...]
+static int glob_match(const char *p, const char *s) {
+    const char *star_p = NULL, *star_s = NULL;
+
+    // wildcards never match a leading dot
+    if (*s == '.' && *p != '.') return 0;
+
+    while (*s) {
+        if (*p == '*') {
+            while (*p == '*') p++;
+            star_p = p;
+            star_s = s;
+            continue;
+        }
+
+        if (*p == '?') {
+            p++; s++;
+            continue;
+        }
+
+        if (*p == '\\' && p[1]) {
+            // escaped character: matches only itself
+            if (p[1] == *s) { p += 2; s++; continue; }
+        } else if (*p == '[') {
+            const char *next;
+            int r = class_match(p, (unsigned char)*s, &next);
+            if (r == 1) { p = next; s++; continue; }
+            if (r < 0 && *s == '[') { p++; s++; continue; }
+        } else if (*p == *s) {
+            p++; s++;
+            continue;
+        }
+
+        // mismatch: let the last * swallow one more character
+        if (!star_p) return 0;
+        p = star_p;
+        s = ++star_s;
+    }
+
+    while (*p == '*') p++;
+    return *p == '\0';
+}
+
+// is entry i of a listing a directory? d_type may be unknown or a symlink
+static int entry_is_dir(const DirCache *dc, int i, const char *path, int follow_links) {
+    unsigned char t = dc->types[i];
+    if (t == DT_DIR) return 1;
+    if (t != DT_UNKNOWN && !(t == DT_LNK && follow_links)) return 0;
+
+    char full[PATH_MAX];
+    struct stat st;
+    snprintf(full, sizeof(full), "%s/%s", path, dc->names + dc->offs[i]);
+    if (follow_links ? stat(full, &st) : lstat(full, &st)) return 0;
+    return S_ISDIR(st.st_mode);
+}
+
+// append "/name" to path, returns the old length to restore later
+static size_t path_push(char *path, size_t len, const char *name) {
+    size_t n = strlen(name);
+    size_t add = (len > 0 && path[len - 1] != '/') ? 1 : 0;
+    if (len + add + n >= PATH_MAX) return (size_t)-1;
+    if (add) path[len] = '/';
+    memcpy(path + len + add, name, n + 1);
+    return len + add + n;
+}
+
+// walk pattern components comps[idx..] below path
+static void glob_walk(char *path, size_t len, char **comps, int ncomp, int idx,
+                      int dir_only, StrVec *out) {
+    const char *dir = len ? path : ".";
+
+    if (idx == ncomp) {
+        struct stat st;
+        // a bare top-level ** matching zero directories names nothing
+        if (len == 0) return;
+        if (lstat(dir, &st) != 0) return;
+        if (dir_only) {
+            // "pattern/" only matches directories and keeps the slash
+            if (stat(dir, &st) != 0 || !S_ISDIR(st.st_mode)) return;
+            char *s = malloc(len + 2);
+            if (s) {
+                memcpy(s, path, len);
+                s[len] = '/';
+                s[len + 1] = '\0';
+            }
+            strvec_push(out, s);
+            return;
+        }
+        strvec_push(out, strdup(path));
+        return;
+    }
+
+    const char *comp = comps[idx];
+
+    // literal component: no directory read needed
+    if (!has_glob(comp)) {
+        char lit[PATH_MAX];
+        if (strlen(comp) >= sizeof(lit)) return;
+        glob_unescape(lit, comp);
+        size_t nlen = path_push(path, len, lit);
+        if (nlen == (size_t)-1) return;
+        glob_walk(path, nlen, comps, ncomp, idx + 1, dir_only, out);
+        path[len] = '\0';
+        return;
+    }
+
+    DirCache *dc = dircache_get(dir);
+    if (!dc) return;
+
+    int globstar = (strcmp(comp, "**") == 0);
+
+    // ** matches zero directories too
+    if (globstar) glob_walk(path, len, comps, ncomp, idx + 1, dir_only, out);
+
+    for (int i = 0; i < dc->count; i++) {
+        const char *name = dc->names + dc->offs[i];
+
+        if (globstar) {
+            // descend into every visible real directory, keeping ** in place;
+            // a trailing ** also matches the files at each level
+            if (name[0] == '.') continue;
+            int is_dir = entry_is_dir(dc, i, dir, 0);
+            if (!is_dir && (idx + 1 < ncomp || dir_only)) continue;
+            size_t nlen = path_push(path, len, name);
+            if (nlen == (size_t)-1) continue;
+            if (is_dir) glob_walk(path, nlen, comps, ncomp, idx, dir_only, out);
+            else strvec_push(out, strdup(path));
+            path[len] = '\0';
+            continue;
+        }
+
+        if (!glob_match(comp, name)) continue;
+        if (idx + 1 < ncomp && !entry_is_dir(dc, i, dir, 1)) continue;
+
+        size_t nlen = path_push(path, len, name);
+        if (nlen == (size_t)-1) continue;
+        glob_walk(path, nlen, comps, ncomp, idx + 1, dir_only, out);
+        path[len] = '\0';
+    }
+
+    dircache_put(dc);
+}
+
+static int cmp_str(const void *a, const void *b) {
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+// expand one pattern into sorted matches appended to out; 0 if nothing matched
+static int glob_expand(const char *pattern, StrVec *out) {
+    char *copy = strdup(pattern);
+    if (!copy) return 0;
+
+    size_t plen = strlen(copy);
+    int dir_only = (plen > 1 && copy[plen - 1] == '/');
+
+    char *comps[MAX_LINE / 2 + 1];
+    int ncomp = 0;
+    for (char *tok = strtok(copy, "/"); tok; tok = strtok(NULL, "/")) {
+        comps[ncomp++] = tok;
+    }
+
+    char path[PATH_MAX];
+    size_t len = 0;
+    path[0] = '\0';
+    if (pattern[0] == '/') {
+        path[0] = '/';
+        path[1] = '\0';
+        len = 1;
+    }
+
+    int start = out->n;
+    glob_walk(path, len, comps, ncomp, 0, dir_only, out);
+    free(copy);
+
+    int found = out->n - start;
+    if (found > 1) {
+        qsort(out->v + start, found, sizeof(char *), cmp_str);
+
+        // "**/**" style patterns can reach a path twice
+        int w = start + 1;
+        for (int r = start + 1; r < out->n; r++) {
+            if (strcmp(out->v[r], out->v[w - 1]) == 0) free(out->v[r]);
+            else out->v[w++] = out->v[r];
+        }
+        out->n = w;
+        out->v[w] = NULL;
+    }
+    return out->n - start;
+}
+
+// build the final heap argv, replacing words that have a glob pattern with
+// its matches. Takes ownership of words and pats; a pattern with no matches
+// is passed as the plain word.
+static int expand_args(char *words[], char *pats[], int nwords, char ***out) {
+    StrVec sv = {0};
+
+    for (int i = 0; i < nwords; i++) {
+        int matched = pats[i] && glob_expand(pats[i], &sv) > 0;
+        free(pats[i]);
+        if (matched) {
+            free(words[i]);
+            continue;
+        }
+        if (strvec_push(&sv, words[i]) != 0) {
+            for (int j = i + 1; j < nwords; j++) { free(words[j]); free(pats[j]); }
+            cleanup(sv.v, sv.n, NULL, 0);
+            return -1;
+        }
+    }
+
+    *out = sv.v;
+    return sv.n;
+}
+
+// export [NAME[=value]...], with no args lists exported variables
+static int builtin_export(int argc, char **argv) {
+    if (argc == 1) {
+        for (size_t i = 0; i < g_vars_cap; i++) {
+            if (g_vars[i].name && g_vars[i].exported && g_vars[i].value) {
+                printf("export %s=\"%s\"\n", g_vars[i].name, g_vars[i].value);
+            }
+        }
+        return 0;
+    }
+
+    int status = 0;
+    for (int a = 1; a < argc; a++) {
+        const char *eq = strchr(argv[a], '=');
+        size_t n = eq ? (size_t)(eq - argv[a]) : strlen(argv[a]);
+        char *name = strndup(argv[a], n);
+        if (!name) return 1;
+
+        int valid = n > 0 && is_name_char(name[0], 1);
+        for (size_t c = 1; valid && c < n; c++) valid = is_name_char(name[c], 0);
+        if (!valid) {
+            fprintf(stderr, "export: %s: not a valid identifier\n", argv[a]);
+            status = 1;
+        } else {
+            var_set(name, eq ? eq + 1 : NULL, 1);
+        }
+        free(name);
+    }
+    return status;
+}
+
+// ---------------- ulimit / taskset ----------------
+
+// limits the ulimit built-in knows; values are in units of scale bytes
+typedef struct {
+    int resource;
+    char opt;
+    const char *name;
+    rlim_t scale;
+} LimitInfo;
+
+static const LimitInfo g_limit_info[] = {
+    {RLIMIT_CORE,    'c', "core file size (KiB)",      1024},
+    {RLIMIT_DATA,    'd', "data seg size (KiB)",       1024},
+    {RLIMIT_FSIZE,   'f', "file size (KiB)",           1024},
+    {RLIMIT_MEMLOCK, 'l', "max locked memory (KiB)",   1024},
+    {RLIMIT_RSS,     'm', "max memory size (KiB)",     1024},
+    {RLIMIT_NOFILE,  'n', "open files",                1},
+    {RLIMIT_STACK,   's', "stack size (KiB)",          1024},
+    {RLIMIT_CPU,     't', "cpu time (seconds)",        1},
+    {RLIMIT_NPROC,   'u', "max user processes",        1},
+    {RLIMIT_AS,      'v', "virtual memory (KiB)",      1024},
+};
+#define NUM_LIMITS ((int)(sizeof(g_limit_info) / sizeof(g_limit_info[0])))
+
+// limits set with ulimit; the shell itself keeps its own limits and each
+// child applies these between fork and exec
+typedef struct {
+    int set_soft, set_hard;
+    rlim_t soft, hard;
+} PendingLimit;
+
+static PendingLimit g_limits[NUM_LIMITS];
+
+// default CPU affinity for children, set by "taskset LIST" with no command
+static cpu_set_t g_affinity;
+static int g_affinity_set = 0;
+
+// current value as a child would see it
+static void limit_effective(int i, struct rlimit *rl) {
+    getrlimit(g_limit_info[i].resource, rl);
+    if (g_limits[i].set_soft) rl->rlim_cur = g_limits[i].soft;
+    if (g_limits[i].set_hard) rl->rlim_max = g_limits[i].hard;
+}
+
+static void limit_print(int i, int hard, int with_name) {
+    struct rlimit rl;
+    limit_effective(i, &rl);
+    rlim_t v = hard ? rl.rlim_max : rl.rlim_cur;
+
+    if (with_name) printf("%-28s (-%c) ", g_limit_info[i].name, g_limit_info[i].opt);
+    if (v == RLIM_INFINITY) printf("unlimited\n");
+    else printf("%llu\n", (unsigned long long)(v / g_limit_info[i].scale));
+}
+
+// only CAP_SYS_RESOURCE may raise a hard limit
+static int can_raise_hard(void) {
+    struct __user_cap_header_struct hdr = {_LINUX_CAPABILITY_VERSION_3, 0};
+    struct __user_cap_data_struct data[2];
+    if (syscall(SYS_capget, &hdr, data) != 0) return 0;
+    return (data[CAP_SYS_RESOURCE / 32].effective >> (CAP_SYS_RESOURCE % 32)) & 1;
+}
+
+// ulimit [-S|-H] [-a] [-cdflmnstuv] [value|unlimited]
+static int builtin_ulimit(int argc, char **argv) {
+    int sflag = 0, hflag = 0;
+    int which = -1;
+    int all = 0;
+    const char *value = NULL;
+
+    for (int a = 1; a < argc; a++) {
+        const char *arg = argv[a];
+        if (arg[0] != '-' || arg[1] == '\0') {
+            value = arg;
+            continue;
+        }
+        for (int c = 1; arg[c]; c++) {
+            if (arg[c] == 'S') { sflag = 1; continue; }
+            if (arg[c] == 'H') { hflag = 1; continue; }
+            if (arg[c] == 'a') { all = 1; continue; }
+
+            int found = -1;
+            for (int i = 0; i < NUM_LIMITS; i++) {
+                if (g_limit_info[i].opt == arg[c]) found = i;
+            }
+            if (found < 0) {
+                fprintf(stderr, "ulimit: -%c: invalid option\n", arg[c]);
+                return 1;
+            }
+            which = found;
+        }
+    }
+
+    // setting changes both limits unless -S or -H narrows it;
+    // queries print the soft limit unless only -H was given
+    int soft = sflag || !hflag;
+    int hard = hflag || !sflag;
+    int show_hard = hflag && !sflag;
+
+    if (all) {
+        for (int i = 0; i < NUM_LIMITS; i++) limit_print(i, show_hard, 1);
+        return 0;
+    }
 
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include <unistd.h>
-#include <sys/wait.h>
-#include <fcntl.h>
-#include <errno.h>
+    // default resource is file size, like sh
+    if (which < 0) which = 2;
 
-#define MAX_LINE 1024
-#define MAX_ARGS 128
+    if (!value) {
+        limit_print(which, show_hard, 0);
+        return 0;
+    }
 
-// remove trailing newline
-static void trim_newline(char *s) {
-    s[strcspn(s, "\n")] = 0;
+    rlim_t v;
+    if (strcmp(value, "unlimited") == 0) {
+        v = RLIM_INFINITY;
+    } else {
+        char *end;
+        errno = 0;
+        unsigned long long n = strtoull(value, &end, 10);
+        if (errno || *end || value[0] == '-') {
+            fprintf(stderr, "ulimit: %s: invalid number\n", value);
+            return 1;
+        }
+        rlim_t scale = g_limit_info[which].scale;
+        if (n >= RLIM_INFINITY / scale) {
+            fprintf(stderr, "ulimit: %s: value too large\n", value);
+            return 1;
+        }
+        v = (rlim_t)n * scale;
+    }
+
+    // refuse values the child could never set, so errors show up here
+    struct rlimit cur;
+    limit_effective(which, &cur);
+    if (soft && !hard && v > cur.rlim_max) {
+        fprintf(stderr, "ulimit: %s: soft limit above hard limit\n", g_limit_info[which].name);
+        return 1;
+    }
+    if (hard && !soft && v < cur.rlim_cur) {
+        fprintf(stderr, "ulimit: %s: hard limit below soft limit\n", g_limit_info[which].name);
+        return 1;
+    }
+    if (hard && v > cur.rlim_max && !can_raise_hard()) {
+        fprintf(stderr, "ulimit: %s: cannot raise hard limit\n", g_limit_info[which].name);
+        return 1;
+    }
+
+    if (soft) { g_limits[which].set_soft = 1; g_limits[which].soft = v; }
+    if (hard) { g_limits[which].set_hard = 1; g_limits[which].hard = v; }
+    return 0;
 }
 
-// free malloc'd args and redirection strings
-static void cleanup(char *argv[], int argc, char *inFile, char *outFile) {
-    for (int i = 0; i < argc; i++) {
-        free(argv[i]);
+// parse "0-3,6" (list) or "f" / "0xf" (hex mask) into a cpu set
+static int parse_cpus(const char *s, int is_list, cpu_set_t *set) {
+    CPU_ZERO(set);
+
+    if (is_list) {
+        const char *p = s;
+        while (*p) {
+            char *end;
+            long lo = strtol(p, &end, 10);
+            if (end == p || lo < 0) return -1;
+            long hi = lo;
+            p = end;
+            if (*p == '-') {
+                hi = strtol(p + 1, &end, 10);
+                if (end == p + 1 || hi < lo) return -1;
+                p = end;
+            }
+            if (hi >= CPU_SETSIZE) return -1;
+            for (long c = lo; c <= hi; c++) CPU_SET((int)c, set);
+            if (*p == ',') p++;
+            else if (*p) return -1;
+        }
+    } else {
+        if (s[0] == '0' && (s[1] == 'x' || s[1] == 'X')) s += 2;
+        size_t n = strlen(s);
+        if (n == 0) return -1;
+        // walk hex digits from the least significant end
+        for (size_t d = 0; d < n; d++) {
+            char ch = s[n - 1 - d];
+            int v;
+            if (ch >= '0' && ch <= '9') v = ch - '0';
+            else if (ch >= 'a' && ch <= 'f') v = ch - 'a' + 10;
+            else if (ch >= 'A' && ch <= 'F') v = ch - 'A' + 10;
+            else return -1;
+            for (int b = 0; b < 4; b++) {
+                int cpu = (int)d * 4 + b;
+                if ((v >> b) & 1) {
+                    if (cpu >= CPU_SETSIZE) return -1;
+                    CPU_SET(cpu, set);
+                }
+            }
+        }
     }
-    if (inFile) free(inFile);
-    if (outFile) free(outFile);
+    return CPU_COUNT(set) > 0 ? 0 : -1;
 }
 
-// parse input line into argv and detect <, >, >>
-static int parse_line(const char *line, char *argv[], int max_args,
-                      char **inFile, char **outFile, int *append) {
-    int argc = 0;
-    int i = 0;
-    int len = (int)strlen(line);
+static void print_cpus(const cpu_set_t *set) {
+    int first = 1;
+    for (int c = 0; c < CPU_SETSIZE; c++) {
+        if (!CPU_ISSET(c, set)) continue;
+        int e = c;
+        while (e + 1 < CPU_SETSIZE && CPU_ISSET(e + 1, set)) e++;
+        printf(first ? "%d" : ",%d", c);
+        if (e > c) printf("-%d", e);
+        first = 0;
+        c = e;
+    }
+    printf("\n");
+}
 
-    *inFile = NULL;
-    *outFile = NULL;
-    *append = 0;
+// drop the first k words of a heap argv
+static void shift_args(char **argv, int *argc, int k) {
+    for (int i = 0; i < k; i++) free(argv[i]);
+    memmove(argv, argv + k, (*argc - k + 1) * sizeof(char *));
+    *argc -= k;
+}
 
-    while (i < len) {
-        // skip spaces/tabs
-        while (i < len && (line[i] == ' ' || line[i] == '\t')) i++;
-        if (i >= len) break;
+// taskset [-c] MASK|LIST [cmd args...]
+// With a command it is stripped off argv and *cpus is filled for that child.
+// Returns 1 if a command remains to run, 0 if handled, -1 on error.
+static int builtin_taskset(char **argv, int *argc, cpu_set_t *cpus) {
+    int is_list = 0;
+    int a = 1;
 
-        // input redirect <
-        if (line[i] == '<') {
-            i++;
-            while (i < len && (line[i] == ' ' || line[i] == '\t')) i++;
-            if (i >= len) return -1;
+    if (a < *argc && strcmp(argv[a], "-c") == 0) {
+        is_list = 1;
+        a++;
+    }
 
-            char *fname = malloc(MAX_LINE);
-            if (!fname) return -1;
+    if (a >= *argc) {
+        cpu_set_t cur;
+        if (g_affinity_set) cur = g_affinity;
+        else sched_getaffinity(0, sizeof(cur), &cur);
+        printf("affinity list: ");
+        print_cpus(&cur);
+        return 0;
+    }
 
-            int k = 0;
-            if (line[i] == '"') {
-                i++;
-                while (i < len && line[i] != '"' && k < MAX_LINE - 1) fname[k++] = line[i++];
-                if (i < len && line[i] == '"') i++;
-            } else {
-                while (i < len && line[i] != ' ' && line[i] != '\t' && k < MAX_LINE - 1) fname[k++] = line[i++];
-            }
-            fname[k] = '\0';
-            *inFile = fname;
-            continue;
+    if (parse_cpus(argv[a], is_list, cpus) != 0) {
+        fprintf(stderr, "taskset: %s: invalid CPU %s\n", argv[a], is_list ? "list" : "mask");
+        return -1;
+    }
+
+    if (a + 1 >= *argc) {
+        g_affinity = *cpus;
+        g_affinity_set = 1;
+        return 0;
+    }
+
+    shift_args(argv, argc, a + 1);
+    return 1;
+}
+
+// child side: apply pending ulimits and CPU affinity before exec
+static int apply_limits(const cpu_set_t *cpus) {
+    for (int i = 0; i < NUM_LIMITS; i++) {
+        if (!g_limits[i].set_soft && !g_limits[i].set_hard) continue;
+
+        struct rlimit rl;
+        limit_effective(i, &rl);
+        if (setrlimit(g_limit_info[i].resource, &rl) != 0) {
+            fprintf(stderr, "ulimit: %s: %s\n", g_limit_info[i].name, strerror(errno));
+            return -1;
         }
+    }
 
-        // output redirect > or >>
-        if (line[i] == '>') {
-            i++;
-            if (i < len && line[i] == '>') {
-                *append = 1;
-                i++;
-            } else {
-                *append = 0;
-            }
+    if (!cpus && g_affinity_set) cpus = &g_affinity;
+    if (cpus && sched_setaffinity(0, sizeof(cpu_set_t), cpus) != 0) {
+        fprintf(stderr, "taskset: %s\n", strerror(errno));
+        return -1;
+    }
+    return 0;
+}
 
-            while (i < len && (line[i] == ' ' || line[i] == '\t')) i++;
-            if (i >= len) return -1;
+// ---------------- coprocesses ----------------
 
-            char *fname = malloc(MAX_LINE);
-            if (!fname) return -1;
+// a long-lived child whose stdin/stdout are pipes held by the shell.
+// Later commands talk to it through fd redirections, e.g. "echo hi >&10"
+// and "head -n1 <&11", so the helper stays warm across commands.
+typedef struct {
+    char name[32];
+    pid_t pid;          // 0 if the slot is free
+    int to_fd;          // write end, feeds the coprocess stdin
+    int from_fd;        // read end, carries its stdout
+    int running;
+    int status;         // wait status once it has exited
+} Coproc;
 
-            int k = 0;
-            if (line[i] == '"') {
-                i++;
-                while (i < len && line[i] != '"' && k < MAX_LINE - 1) fname[k++] = line[i++];
-                if (i < len && line[i] == '"') i++;
-            } else {
-                while (i < len && line[i] != ' ' && line[i] != '\t' && k < MAX_LINE - 1) fname[k++] = line[i++];
-            }
-            fname[k] = '\0';
-            *outFile = fname;
+static Coproc g_coprocs[MAX_COPROCS];
+
+// coproc fds live above the range people redirect by hand
+#define COPROC_FD_BASE 10
+
+static Coproc *coproc_find(const char *name) {
+    for (int i = 0; i < MAX_COPROCS; i++) {
+        if (g_coprocs[i].pid && strcmp(g_coprocs[i].name, name) == 0) return &g_coprocs[i];
+    }
+    return NULL;
+}
+
+static int is_coproc_name(const char *s) {
+    if (!*s) return 0;
+    for (; *s; s++) {
+        if (!((*s >= 'A' && *s <= 'Z') || *s == '_' || (*s >= '0' && *s <= '9'))) return 0;
+    }
+    return 1;
+}
+
+static void coproc_report(const Coproc *cp) {
+    if (WIFEXITED(cp->status)) {
+        printf("[coproc %s] %d done (exit %d)\n", cp->name, (int)cp->pid, WEXITSTATUS(cp->status));
+    } else if (WIFSIGNALED(cp->status)) {
+        printf("[coproc %s] %d killed (signal %d)\n", cp->name, (int)cp->pid, WTERMSIG(cp->status));
+    }
+}
+
+// publish NAME_PID, NAME_IN (write into it) and NAME_OUT (read from it)
+// as shell variables, so commands can say "echo hi >&$BC_IN"
+static void coproc_vars(const Coproc *cp, int publish) {
+    static const char *suffix[] = {"_PID", "_IN", "_OUT"};
+    int vals[] = {(int)cp->pid, cp->to_fd, cp->from_fd};
+    char name[64], num[32];
+
+    for (int i = 0; i < 3; i++) {
+        snprintf(name, sizeof(name), "%s%s", cp->name, suffix[i]);
+        if (!publish) {
+            var_unset(name);
             continue;
         }
+        snprintf(num, sizeof(num), "%d", vals[i]);
+        var_set(name, num, 0);
+    }
+}
 
-        // normal argument (quoted or not)
-        if (argc >= max_args - 1) break;
+// close both pipe ends and forget the coprocess
+static void coproc_release(Coproc *cp) {
+    coproc_vars(cp, 0);
+    if (cp->to_fd >= 0) close(cp->to_fd);
+    if (cp->from_fd >= 0) close(cp->from_fd);
+    memset(cp, 0, sizeof(*cp));
+    cp->to_fd = cp->from_fd = -1;
+}
+
+// collect coprocesses that exited on their own (non-blocking)
+static void coproc_reap(void) {
+    for (int i = 0; i < MAX_COPROCS; i++) {
+        Coproc *cp = &g_coprocs[i];
+        if (!cp->pid || !cp->running) continue;
+        if (waitpid(cp->pid, &cp->status, WNOHANG) == cp->pid) {
+            cp->running = 0;
+            coproc_report(cp);
+        }
+    }
+}
+
+// wait for a coprocess whose stdin was just closed. A helper that ignores
+// EOF gets a grace period, then SIGTERM, then SIGKILL, so it can't hang the
+// shell.
+#define COPROC_GRACE_MS 500
+
+static void coproc_stop(Coproc *cp) {
+    static const int sigs[] = {0, SIGTERM, SIGKILL};
+    struct timespec tick = {0, 10 * 1000000L};
+
+    for (int step = 0; step < 3; step++) {
+        if (sigs[step]) kill(cp->pid, sigs[step]);
+        for (int t = 0; t < COPROC_GRACE_MS / 10; t++) {
+            pid_t r = waitpid(cp->pid, &cp->status, WNOHANG);
+            if (r == cp->pid) return;
+            if (r < 0 && errno != EINTR) return;
+            nanosleep(&tick, NULL);
+        }
+    }
+}
+
+// start argv as coprocess name; the child gets limits and redirections too
+static int coproc_start(const char *name, char **argv, const Redir redirs[], int nredir) {
+    Coproc *old = coproc_find(name);
+    if (old && old->running) {
+        fprintf(stderr, "coproc: %s: already running\n", name);
+        return -1;
+    }
+    if (old) coproc_release(old);
+
+    Coproc *cp = NULL;
+    for (int i = 0; i < MAX_COPROCS && !cp; i++) {
+        if (!g_coprocs[i].pid) cp = &g_coprocs[i];
+    }
+    if (!cp) {
+        fprintf(stderr, "coproc: too many coprocesses (max %d)\n", MAX_COPROCS);
+        return -1;
+    }
+
+    env_sync();
+
+    int in[2], out[2];
+    if (pipe2(in, O_CLOEXEC) != 0) {
+        fprintf(stderr, "coproc: pipe: %s\n", strerror(errno));
+        return -1;
+    }
+    if (pipe2(out, O_CLOEXEC) != 0) {
+        fprintf(stderr, "coproc: pipe: %s\n", strerror(errno));
+        close(in[0]);
+        close(in[1]);
+        return -1;
+    }
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        fprintf(stderr, "fork failed: %s\n", strerror(errno));
+        close(in[0]); close(in[1]);
+        close(out[0]); close(out[1]);
+        return -1;
+    }
+
+    if (pid == 0) {
+        dup2(in[0], STDIN_FILENO);
+        dup2(out[1], STDOUT_FILENO);
+        if (apply_limits(NULL) != 0) exit(1);
+        if (apply_redirs(redirs, nredir, 1) != 0) exit(1);
+
+        execvp(argv[0], argv);
+        if (errno == ENOENT) fprintf(stderr, "%s: command not found\n", argv[0]);
+        else fprintf(stderr, "%s: %s\n", argv[0], strerror(errno));
+        exit(127);
+    }
+
+    close(in[0]);
+    close(out[1]);
+
+    // move the shell's ends out of the way of hand-written fd numbers
+    cp->to_fd = fcntl(in[1], F_DUPFD_CLOEXEC, COPROC_FD_BASE);
+    cp->from_fd = fcntl(out[0], F_DUPFD_CLOEXEC, COPROC_FD_BASE);
+    close(in[1]);
+    close(out[0]);
+
+    snprintf(cp->name, sizeof(cp->name), "%s", name);
+    cp->pid = pid;
+    cp->running = 1;
+    cp->status = 0;
+
+    coproc_vars(cp, 1);
+    printf("[coproc %s] %d write>&%d read<&%d\n", cp->name, (int)pid, cp->to_fd, cp->from_fd);
+    return 0;
+}
+
+// coproc                        list coprocesses
+// coproc [NAME] cmd args...     start one (NAME is upper case, default COPROC)
+// coproc -c [NAME]              close its stdin, wait for it and release it
+static int builtin_coproc(int argc, char **argv, const Redir redirs[], int nredir) {
+    if (argc == 1) {
+        for (int i = 0; i < MAX_COPROCS; i++) {
+            Coproc *cp = &g_coprocs[i];
+            if (!cp->pid) continue;
+            printf("%-12s pid=%d write>&%d read<&%d %s\n", cp->name, (int)cp->pid,
+                   cp->to_fd, cp->from_fd, cp->running ? "running" : "exited");
+        }
+        return 0;
+    }
+
+    if (strcmp(argv[1], "-c") == 0) {
+        const char *name = (argc > 2) ? argv[2] : "COPROC";
+        Coproc *cp = coproc_find(name);
+        if (!cp) {
+            fprintf(stderr, "coproc: %s: no such coprocess\n", name);
+            return 1;
+        }
+
+        // EOF on its stdin lets a filter finish; unread output is dropped
+        close(cp->to_fd);
+        cp->to_fd = -1;
+        if (cp->running) {
+            close(cp->from_fd);
+            cp->from_fd = -1;
+            coproc_stop(cp);
+            cp->running = 0;
+            coproc_report(cp);
+        }
+        coproc_release(cp);
+        return 0;
+    }
+
+    const char *name = "COPROC";
+    int a = 1;
+    if (argc > 2 && is_coproc_name(argv[1])) {
+        name = argv[1];
+        a = 2;
+    }
+    return coproc_start(name, argv + a, redirs, nredir) == 0 ? 0 : 1;
+}
+
+// ---------------- zero-copy cat / tee ----------------
 
-        char *arg = malloc(MAX_LINE);
-        if (!arg) return -1;
+// built-ins that honor redirections apply them in the shell itself; these
+// remember the original fds so they can be put back afterwards
+typedef struct {
+    int fd;
+    int saved;      // -1 if fd was closed before
+} SavedFd;
+
+static int save_one(SavedFd saved[], int n, int fd) {
+    for (int i = 0; i < n; i++) {
+        if (saved[i].fd == fd) return n;
+    }
+    saved[n].fd = fd;
+    saved[n].saved = fcntl(fd, F_DUPFD_CLOEXEC, COPROC_FD_BASE);
+    return n + 1;
+}
+
+static int redirs_save(const Redir redirs[], int nredir, SavedFd saved[]) {
+    int n = 0;
+    for (int r = 0; r < nredir; r++) {
+        if (redirs[r].type == REDIR_ENV) continue;
+        if (redirs[r].fd < 0) {
+            n = save_one(saved, n, STDOUT_FILENO);
+            n = save_one(saved, n, STDERR_FILENO);
+        } else {
+            n = save_one(saved, n, redirs[r].fd);
+        }
+    }
+    return n;
+}
 
-        int k = 0;
-        if (line[i] == '"') {
-            i++;
-            while (i < len && line[i] != '"' && k < MAX_LINE - 1) arg[k++] = line[i++];
-            if (i < len && line[i] == '"') i++;
+static void redirs_restore(SavedFd saved[], int n) {
+    for (int i = n - 1; i >= 0; i--) {
+        if (saved[i].saved >= 0) {
+            dup2(saved[i].saved, saved[i].fd);
+            close(saved[i].saved);
         } else {
-            while (i < len && line[i] != ' ' && line[i] != '\t' && k < MAX_LINE - 1) {
-                if (line[i] == '<' || line[i] == '>') break;
-                arg[k++] = line[i++];
+            close(saved[i].fd);
+        }
+    }
+}
+
+static int is_pipe(int fd) {
+    struct stat st;
+    return fstat(fd, &st) == 0 && S_ISFIFO(st.st_mode);
+}
+
+static int is_regular(int fd) {
+    struct stat st;
+    return fstat(fd, &st) == 0 && S_ISREG(st.st_mode);
+}
+
+// plain read/write loop, the last resort
+static int copy_rw(int in, int out) {
+    static char buf[COPY_CHUNK];
+    for (;;) {
+        ssize_t n = read(in, buf, sizeof(buf));
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) return -1;
+        if (n == 0) return 0;
+
+        for (ssize_t off = 0; off < n;) {
+            ssize_t w = write(out, buf + off, n - off);
+            if (w < 0 && errno == EINTR) continue;
+            if (w < 0) return -1;
+            off += w;
+        }
+    }
+}
+
+// move everything from in to out without copying through user space when
+// the kernel allows it: copy_file_range between regular files, splice when
+// either side is a pipe, sendfile from a regular file to anything else.
+// Each one falls through to the next if the kernel refuses the fd pair.
+static int copy_fd(int in, int out) {
+    int moved = 0;      // once data has moved we can't switch methods
+
+    if (is_regular(in) && is_regular(out)) {
+        for (;;) {
+            ssize_t n = copy_file_range(in, NULL, out, NULL, COPY_CHUNK * 16, 0);
+            if (n > 0) { moved = 1; continue; }
+            if (n == 0) return 0;
+            if (errno == EINTR) continue;
+            if (moved || (errno != EXDEV && errno != EINVAL && errno != ENOSYS &&
+                          errno != EOPNOTSUPP && errno != EBADF)) return -1;
+            break;
+        }
+    }
+
+    if (is_pipe(in) || is_pipe(out)) {
+        for (;;) {
+            ssize_t n = splice(in, NULL, out, NULL, COPY_CHUNK * 16, SPLICE_F_MOVE | SPLICE_F_MORE);
+            if (n > 0) { moved = 1; continue; }
+            if (n == 0) return 0;
+            if (errno == EINTR) continue;
+            if (moved || errno != EINVAL) return -1;
+            break;
+        }
+    }
+
+    if (is_regular(in)) {
+        for (;;) {
+            ssize_t n = sendfile(out, in, NULL, COPY_CHUNK * 16);
+            if (n > 0) { moved = 1; continue; }
+            if (n == 0) return 0;
+            if (errno == EINTR) continue;
+            if (moved || (errno != EINVAL && errno != ENOSYS)) return -1;
+            break;
+        }
+    }
+
+    return copy_rw(in, out);
+}
+
+// cat [file|-]...  (anything with options goes to the external cat)
+static int builtin_cat(int argc, char **argv) {
+    int status = 0;
+
+    if (argc == 1) {
+        if (copy_fd(STDIN_FILENO, STDOUT_FILENO) != 0) {
+            fprintf(stderr, "cat: %s\n", strerror(errno));
+            return 1;
+        }
+        return 0;
+    }
+
+    for (int a = 1; a < argc; a++) {
+        int fd = STDIN_FILENO;
+        if (strcmp(argv[a], "-") != 0) {
+            fd = open(argv[a], O_RDONLY | O_CLOEXEC);
+            if (fd < 0) {
+                fprintf(stderr, "cat: %s: %s\n", argv[a], strerror(errno));
+                status = 1;
+                continue;
             }
         }
-        arg[k] = '\0';
 
-        if (arg[0] == '\0') {
-            free(arg);
+        if (copy_fd(fd, STDOUT_FILENO) != 0) {
+            fprintf(stderr, "cat: %s: %s\n", argv[a], strerror(errno));
+            status = 1;
+        }
+        if (fd != STDIN_FILENO) close(fd);
+        if (status && errno == EPIPE) break;
+    }
+    return status;
+}
+
+// splice exactly n bytes from in to out
+static int splice_all(int in, int out, size_t n) {
+    while (n > 0) {
+        ssize_t m = splice(in, NULL, out, NULL, n, SPLICE_F_MOVE | SPLICE_F_MORE);
+        if (m < 0 && errno == EINTR) continue;
+        if (m <= 0) return -1;
+        n -= (size_t)m;
+    }
+    return 0;
+}
+
+// zero-copy tee: tee(2) duplicates the stdin pipe contents into a scratch
+// pipe which is spliced to each output; the last output consumes stdin.
+// Returns 1 if the kernel refused before any data moved (caller falls back).
+static int tee_splice(const int outs[], int nout) {
+    // nothing to duplicate: with no file arguments tee is just cat, and the
+    // scratch pipe would never be drained
+    if (nout == 1) return copy_fd(STDIN_FILENO, outs[0]) == 0 ? 0 : -1;
+
+    int scratch[2];
+    if (pipe2(scratch, O_CLOEXEC) != 0) return 1;
+
+    int moved = 0;
+    int rc = 0;
+    for (;;) {
+        // chunks stay below the default pipe size so a tee into the empty
+        // scratch pipe always takes the whole chunk
+        ssize_t n = tee(STDIN_FILENO, scratch[1], COPY_CHUNK, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n == 0) break;
+        if (n < 0) {
+            rc = (!moved && errno == EINVAL) ? 1 : -1;
+            break;
+        }
+
+        for (int o = 0; o < nout - 1 && rc == 0; o++) {
+            if (o > 0 && tee(STDIN_FILENO, scratch[1], (size_t)n, 0) != n) rc = -1;
+            else if (splice_all(scratch[0], outs[o], (size_t)n) != 0) rc = (!moved && errno == EINVAL) ? 1 : -1;
+            else moved = 1;
+        }
+        if (rc == 0 && splice_all(STDIN_FILENO, outs[nout - 1], (size_t)n) != 0) {
+            rc = (!moved && errno == EINVAL) ? 1 : -1;
+        }
+        if (rc != 0) break;
+        moved = 1;
+    }
+
+    close(scratch[0]);
+    close(scratch[1]);
+    return rc;
+}
+
+// tee [-a] [file]...
+static int builtin_tee(int argc, char **argv) {
+    int append = 0;
+    int a = 1;
+    if (a < argc && strcmp(argv[a], "-a") == 0) {
+        append = 1;
+        a++;
+    }
+
+    int outs[MAX_ARGS + 1];
+    int nout = 0;
+    int status = 0;
+
+    outs[nout++] = STDOUT_FILENO;
+    for (; a < argc && nout <= MAX_ARGS; a++) {
+        int fd = open(argv[a], O_WRONLY | O_CREAT | O_CLOEXEC | (append ? O_APPEND : O_TRUNC), 0644);
+        if (fd < 0) {
+            fprintf(stderr, "tee: %s: %s\n", argv[a], strerror(errno));
+            status = 1;
             continue;
         }
+        outs[nout++] = fd;
+    }
 
-        argv[argc++] = arg;
+    // splice refuses O_APPEND targets, so those take the buffered path
+    int can_splice = is_pipe(STDIN_FILENO);
+    for (int o = 0; o < nout && can_splice; o++) {
+        if (fcntl(outs[o], F_GETFL) & O_APPEND) can_splice = 0;
     }
 
-    argv[argc] = NULL;
-    return argc;
+    int rc = 1;
+    if (can_splice) rc = tee_splice(outs, nout);
+
+    if (rc == 1) {
+        // stdin is not a pipe (or splice was refused): copy through a buffer
+        static char buf[COPY_CHUNK];
+        rc = 0;
+        for (;;) {
+            ssize_t n = read(STDIN_FILENO, buf, sizeof(buf));
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) {
+                if (n < 0) rc = -1;
+                break;
+            }
+            for (int o = 0; o < nout; o++) {
+                for (ssize_t off = 0; off < n;) {
+                    ssize_t w = write(outs[o], buf + off, n - off);
+                    if (w < 0 && errno == EINTR) continue;
+                    if (w < 0) { rc = -1; break; }
+                    off += w;
+                }
+            }
+            if (rc != 0) break;
+        }
+    }
+    if (rc != 0) {
+        fprintf(stderr, "tee: %s\n", strerror(errno));
+        status = 1;
+    }
+
+    for (int o = 1; o < nout; o++) close(outs[o]);
+    return status;
+}
+
+typedef int (*BuiltinFn)(int argc, char **argv);
+
+// run a built-in inside the shell with the command's redirections applied,
+// putting the shell's own fds back afterwards
+static int run_in_shell(BuiltinFn fn, int argc, char **argv, const Redir redirs[], int nredir) {
+    SavedFd saved[MAX_REDIRS * 2];
+    int nsaved = redirs_save(redirs, nredir, saved);
+    int status;
+
+    fflush(stdout);
+
+    // a closed reader must not kill the shell
+    void (*old_pipe)(int) = signal(SIGPIPE, SIG_IGN);
+
+    if (apply_redirs(redirs, nredir, 0) != 0) {
+        status = 1;
+    } else {
+        status = fn(argc, argv);
+        fflush(stdout);
+    }
+
+    signal(SIGPIPE, old_pipe);
+    redirs_restore(saved, nsaved);
+    return status;
+}
+
+// run cat/tee inside the shell with the command's redirections applied
+static int run_data_builtin(int argc, char **argv, const Redir redirs[], int nredir) {
+    return run_in_shell(strcmp(argv[0], "cat") == 0 ? builtin_cat : builtin_tee,
+                        argc, argv, redirs, nredir);
+}
+
+// coproc listing and -c: redirections apply to the listing, not a helper
+static int coproc_in_shell(int argc, char **argv) {
+    return builtin_coproc(argc, argv, NULL, 0);
+}
+
+// taskset without a command: query or set the default affinity
+static int taskset_in_shell(int argc, char **argv) {
+    cpu_set_t cpus;
+    return builtin_taskset(argv, &argc, &cpus) < 0 ? 1 : 0;
+}
+
+// does this taskset line name a command to run?
+static int taskset_has_command(int argc, char **argv) {
+    int a = (argc > 1 && strcmp(argv[1], "-c") == 0) ? 2 : 1;
+    return a + 1 < argc;
+}
+
+// true if argv is a cat/tee the built-in handles (no options besides tee -a)
+static int is_data_builtin(int argc, char **argv) {
+    int is_tee = (strcmp(argv[0], "tee") == 0);
+    if (!is_tee && strcmp(argv[0], "cat") != 0) return 0;
+
+    for (int a = 1; a < argc; a++) {
+        if (argv[a][0] != '-' || argv[a][1] == '\0') continue;
+        if (is_tee && a == 1 && strcmp(argv[a], "-a") == 0) continue;
+        return 0;
+    }
+    return 1;
 }
 
 int main() {
     char line[MAX_LINE];
 
+    vars_init();
+
+    for (int i = 0; i < MAX_COPROCS; i++) {
+        g_coprocs[i].to_fd = g_coprocs[i].from_fd = -1;
+    }
+
     while (1) {
+        coproc_reap();
+
         printf("myshell> ");
         fflush(stdout);
 
@@ -134,25 +2051,45 @@ int main() {
 
         if (strlen(line) == 0) continue;
 
-        char *argv[MAX_ARGS];
-        char *inFile = NULL;
-        char *outFile = NULL;
-        int append = 0;
+        char *words[MAX_ARGS];
+        char *pats[MAX_ARGS];
+        Redir redirs[MAX_REDIRS];
+        int nredir = 0;
 
-        int argc = parse_line(line, argv, MAX_ARGS, &inFile, &outFile, &append);
-        if (argc < 0) {
+        int nwords = parse_line(line, words, pats, MAX_ARGS, redirs, &nredir);
+        if (nwords < 0) {
             fprintf(stderr, "Parse error.\n");
-            cleanup(argv, 0, inFile, outFile);
+            g_last_status = 2;
+            continue;
+        }
+        if (read_heredocs(redirs, nredir, stdin) != 0) {
+            fprintf(stderr, "here-document: out of memory\n");
+            for (int i = 0; i < nwords; i++) { free(words[i]); free(pats[i]); }
+            cleanup(NULL, 0, redirs, nredir);
+            continue;
+        }
+        if (nwords == 0) {
+            // a line of only NAME=value words sets shell variables
+            for (int r = 0; r < nredir; r++) {
+                if (redirs[r].type == REDIR_ENV) assign_word(redirs[r].arg);
+            }
+            g_last_status = 0;
+            cleanup(NULL, 0, redirs, nredir);
             continue;
         }
-        if (argc == 0) {
-            cleanup(argv, 0, inFile, outFile);
+
+        // expand *, ?, [...] and ** patterns
+        char **argv;
+        int argc = expand_args(words, pats, nwords, &argv);
+        if (argc < 0) {
+            fprintf(stderr, "glob: out of memory\n");
+            cleanup(NULL, 0, redirs, nredir);
             continue;
         }
 
         // built-in: exit
         if (strcmp(argv[0], "exit") == 0) {
-            cleanup(argv, argc, inFile, outFile);
+            cleanup(argv, argc, redirs, nredir);
             break;
         }
 
@@ -161,66 +2098,108 @@ int main() {
             const char *target;
 
             if (argc == 1) {
-                target = getenv("HOME");
+                target = var_get("HOME");
                 if (!target) target = "/";
             } else {
                 target = argv[1];
             }
 
+            g_last_status = 0;
             if (chdir(target) != 0) {
                 fprintf(stderr, "cd: %s: %s\n", target, strerror(errno));
+                g_last_status = 1;
             }
 
-            cleanup(argv, argc, inFile, outFile);
+            cleanup(argv, argc, redirs, nredir);
+            continue;
+        }
+
+        // built-in: ulimit (applies to children only)
+        if (strcmp(argv[0], "ulimit") == 0) {
+            g_last_status = run_in_shell(builtin_ulimit, argc, argv, redirs, nredir);
+            cleanup(argv, argc, redirs, nredir);
+            continue;
+        }
+
+        // built-in: export / unset
+        if (strcmp(argv[0], "export") == 0) {
+            g_last_status = run_in_shell(builtin_export, argc, argv, redirs, nredir);
+            cleanup(argv, argc, redirs, nredir);
+            continue;
+        }
+        if (strcmp(argv[0], "unset") == 0) {
+            for (int a = 1; a < argc; a++) var_unset(argv[a]);
+            g_last_status = 0;
+            cleanup(argv, argc, redirs, nredir);
+            continue;
+        }
+
+        // built-in: coproc
+        if (strcmp(argv[0], "coproc") == 0) {
+            if (argc == 1 || strcmp(argv[1], "-c") == 0)
+                g_last_status = run_in_shell(coproc_in_shell, argc, argv, redirs, nredir);
+            else
+                g_last_status = builtin_coproc(argc, argv, redirs, nredir);
+            cleanup(argv, argc, redirs, nredir);
+            continue;
+        }
+
+        // built-in: cat / tee, moved in-kernel without an exec
+        if (is_data_builtin(argc, argv)) {
+            g_last_status = run_data_builtin(argc, argv, redirs, nredir);
+            cleanup(argv, argc, redirs, nredir);
+            continue;
+        }
+
+        // built-in: taskset, either sets the default or prefixes one command
+        cpu_set_t cmd_cpus;
+        int pinned = 0;
+        if (strcmp(argv[0], "taskset") == 0 && !taskset_has_command(argc, argv)) {
+            g_last_status = run_in_shell(taskset_in_shell, argc, argv, redirs, nredir);
+            cleanup(argv, argc, redirs, nredir);
             continue;
         }
+        if (strcmp(argv[0], "taskset") == 0) {
+            pinned = builtin_taskset(argv, &argc, &cmd_cpus);
+            if (pinned <= 0) {
+                g_last_status = (pinned < 0) ? 1 : 0;
+                cleanup(argv, argc, redirs, nredir);
+                continue;
+            }
+        }
+
+        // children inherit environ as-is; it only changes after an export
+        env_sync();
 
         // fork for external commands
         pid_t pid = fork();
         if (pid < 0) {
             fprintf(stderr, "fork failed: %s\n", strerror(errno));
-            cleanup(argv, argc, inFile, outFile);
+            g_last_status = 1;
+            cleanup(argv, argc, redirs, nredir);
             continue;
         }
 
         if (pid == 0) {
-            // child handles redirection
-
-            if (inFile) {
-                int fd = open(inFile, O_RDONLY);
-                if (fd < 0) {
-                    fprintf(stderr, "input redirect: %s: %s\n", inFile, strerror(errno));
-                    exit(1);
-                }
-                dup2(fd, STDIN_FILENO);
-                close(fd);
-            }
-
-            if (outFile) {
-                int flags = O_WRONLY | O_CREAT;
-                if (append) flags |= O_APPEND;
-                else flags |= O_TRUNC;
-
-                int fd = open(outFile, flags, 0644);
-                if (fd < 0) {
-                    fprintf(stderr, "output redirect: %s: %s\n", outFile, strerror(errno));
-                    exit(1);
-                }
-                dup2(fd, STDOUT_FILENO);
-                close(fd);
-            }
+            // child applies limits, affinity and redirection
+            if (apply_limits(pinned ? &cmd_cpus : NULL) != 0) exit(1);
+            if (apply_redirs(redirs, nredir, 1) != 0) exit(1);
 
             execvp(argv[0], argv);
 
-            // if execvp returns, it failed
-            fprintf(stderr, "%s: command not found\n", argv[0]);
+            // if execvp returns, it failed (big globs can hit E2BIG)
+            if (errno == ENOENT) fprintf(stderr, "%s: command not found\n", argv[0]);
+            else fprintf(stderr, "%s: %s\n", argv[0], strerror(errno));
             exit(127);
         } else {
             int status;
-            waitpid(pid, &status, 0);
+            if (waitpid(pid, &status, 0) == pid) {
+                if (WIFEXITED(status)) g_last_status = WEXITSTATUS(status);
+                else if (WIFSIGNALED(status)) g_last_status = 128 + WTERMSIG(status);
+            }
         }
 
-        cleanup(argv, argc, inFile, outFile);
+        cleanup(argv, argc, redirs, nredir);
     }
 
     printf("\nGoodbye!\n");
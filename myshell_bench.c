@@ -0,0 +1,294 @@
+/*
+    myshell_bench.c
+    Interactive-latency benchmark for myshell
+
+    Starts myshell on a pseudo-terminal, types scripted command lines into it
+    and times how long each takes until the next "myshell> " prompt appears
+    (prompt-to-prompt latency). Each scenario is run a number of times after
+    a warmup and reported as percentiles plus commands per second, so
+    slowdowns in the parse / fork / exec / redirection path show up as
+    numbers instead of "feels slower".
+
+    Usage:
+        ./myshell_bench [-s shell] [-n iterations] [-w warmup]
+                        [-o name-filter] [-c 'command']...
+
+    -c adds a custom scenario (may be repeated). Lines inside one scenario
+    are separated by ';;' and are timed together as one round trip.
+
+    myshell has no '|' pipelines, so the "coproc-roundtrip" scenario stands
+    in for one: a line is written into a warm coprocess and read back.
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <termios.h>
+#include <time.h>
+#include <sys/wait.h>
+
+#define PROMPT "myshell> "
+#define PROMPT_TIMEOUT_MS 10000
+#define MAX_SCENARIOS 32
+
+typedef struct {
+    const char *name;
+    const char *setup;      // run once before timing, may be NULL
+    const char *cmd;        // timed lines, ";;" separated
+    const char *teardown;   // run once after timing, may be NULL
+} Scenario;
+
+static Scenario g_scenarios[MAX_SCENARIOS] = {
+    {"builtin-cd",        NULL, "cd .", NULL},
+    {"builtin-assign",    NULL, "X=1", NULL},
+    {"builtin-expand",    NULL, "X=${HOME:-/}/$?", NULL},
+    {"external-true",     NULL, "true", NULL},
+    {"external-echo",     NULL, "echo hello", NULL},
+    {"redir-out",         NULL, "echo hello >/dev/null", NULL},
+    {"redir-fds",         NULL, "true </dev/null >/dev/null 2>&1", NULL},
+    {"redir-herestring",  NULL, "cat <<<hello >/dev/null", NULL},
+    {"glob-etc",          NULL, "true /etc/*", NULL},
+    {"builtin-cat",       NULL, "cat /etc/hostname >/dev/null", NULL},
+    {"coproc-roundtrip",  "coproc BENCH cat",
+                          "echo ping >&$BENCH_IN;;head -c 5 <&$BENCH_OUT >/dev/null",
+                          "coproc -c BENCH"},
+};
+static int g_nscenarios = 11;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// start the shell on a new pty with echo off; returns the master fd
+static int spawn_shell(const char *path, pid_t *pid_out) {
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) {
+        perror("posix_openpt");
+        return -1;
+    }
+
+    char *slave_name = ptsname(master);
+    if (!slave_name) {
+        perror("ptsname");
+        return -1;
+    }
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork failed");
+        return -1;
+    }
+
+    if (pid == 0) {
+        setsid();
+        int slave = open(slave_name, O_RDWR);
+        if (slave < 0) {
+            perror("open pty slave");
+            exit(1);
+        }
+
+        // without echo the output is just command output and prompts
+        struct termios t;
+        if (tcgetattr(slave, &t) == 0) {
+            t.c_lflag &= ~(ECHO | ECHONL);
+            tcsetattr(slave, TCSANOW, &t);
+        }
+
+        dup2(slave, STDIN_FILENO);
+        dup2(slave, STDOUT_FILENO);
+        dup2(slave, STDERR_FILENO);
+        if (slave > STDERR_FILENO) close(slave);
+        close(master);
+
+        execl(path, path, (char *)NULL);
+        perror("execl failed");
+        exit(127);
+    }
+
+    *pid_out = pid;
+    return master;
+}
+
+// read shell output until a fresh prompt shows up; -1 on timeout/EOF
+static int wait_prompt(int fd) {
+    static char buf[8192];
+    static size_t used = 0;
+    size_t plen = strlen(PROMPT);
+
+    for (;;) {
+        // the prompt may straddle two reads, so keep a small tail around
+        if (used >= plen) {
+            char *hit = memmem(buf, used, PROMPT, plen);
+            if (hit) {
+                size_t rest = used - (size_t)(hit + plen - buf);
+                memmove(buf, hit + plen, rest);
+                used = rest;
+                return 0;
+            }
+            memmove(buf, buf + used - (plen - 1), plen - 1);
+            used = plen - 1;
+        }
+
+        struct pollfd pfd = {fd, POLLIN, 0};
+        int r = poll(&pfd, 1, PROMPT_TIMEOUT_MS);
+        if (r <= 0) return -1;
+
+        ssize_t n = read(fd, buf + used, sizeof(buf) - used);
+        if (n <= 0) return -1;
+        used += (size_t)n;
+    }
+}
+
+// type one line (no newline in s) and wait for the next prompt
+static int run_line(int fd, const char *s, size_t n) {
+    char line[4096];
+    if (n + 1 > sizeof(line)) return -1;
+    memcpy(line, s, n);
+    line[n] = '\n';
+    if (write(fd, line, n + 1) != (ssize_t)(n + 1)) return -1;
+    return wait_prompt(fd);
+}
+
+// run every ";;" separated line of cmd; returns number of lines or -1
+static int run_lines(int fd, const char *cmd) {
+    int count = 0;
+    const char *p = cmd;
+    for (;;) {
+        const char *sep = strstr(p, ";;");
+        size_t n = sep ? (size_t)(sep - p) : strlen(p);
+        if (run_line(fd, p, n) != 0) return -1;
+        count++;
+        if (!sep) break;
+        p = sep + 2;
+    }
+    return count;
+}
+
+static int cmp_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+// nearest-rank percentile of a sorted array
+static uint64_t percentile(const uint64_t *v, int n, double p) {
+    int idx = (int)(p * n + 0.999999) - 1;
+    if (idx < 0) idx = 0;
+    if (idx >= n) idx = n - 1;
+    return v[idx];
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [-s shell] [-n iterations] [-w warmup] [-o name-filter] [-c 'command']...\n",
+            prog);
+}
+
+int main(int argc, char *argv[]) {
+    const char *shell = "./myshell";
+    const char *filter = NULL;
+    int iters = 1000;
+    int warmup = 50;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "s:n:w:o:c:h")) != -1) {
+        switch (opt) {
+        case 's': shell = optarg; break;
+        case 'n': iters = atoi(optarg); break;
+        case 'w': warmup = atoi(optarg); break;
+        case 'o': filter = optarg; break;
+        case 'c':
+            if (g_nscenarios >= MAX_SCENARIOS) {
+                fprintf(stderr, "too many scenarios (max %d)\n", MAX_SCENARIOS);
+                return 1;
+            }
+            g_scenarios[g_nscenarios].name = optarg;
+            g_scenarios[g_nscenarios].cmd = optarg;
+            g_nscenarios++;
+            break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (iters <= 0 || warmup < 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    pid_t pid;
+    int fd = spawn_shell(shell, &pid);
+    if (fd < 0) return 1;
+
+    if (wait_prompt(fd) != 0) {
+        fprintf(stderr, "no prompt from %s\n", shell);
+        return 1;
+    }
+
+    uint64_t *lat = malloc(sizeof(uint64_t) * (size_t)iters);
+    if (!lat) {
+        perror("malloc");
+        return 1;
+    }
+
+    printf("shell: %s | iterations: %d | warmup: %d\n\n", shell, iters, warmup);
+    printf("%-22s %9s %9s %9s %9s %9s %10s\n",
+           "scenario", "p50(us)", "p90(us)", "p99(us)", "max(us)", "mean(us)", "cmds/s");
+
+    int failed = 0;
+    for (int s = 0; s < g_nscenarios; s++) {
+        const Scenario *sc = &g_scenarios[s];
+        if (filter && !strstr(sc->name, filter)) continue;
+
+        if (sc->setup && run_lines(fd, sc->setup) < 0) {
+            fprintf(stderr, "%s: setup failed\n", sc->name);
+            failed = 1;
+            break;
+        }
+
+        int lines = 0;
+        uint64_t total = 0;
+        for (int i = 0; i < warmup + iters; i++) {
+            uint64_t t0 = now_ns();
+            lines = run_lines(fd, sc->cmd);
+            uint64_t t1 = now_ns();
+            if (lines < 0) break;
+            if (i >= warmup) {
+                lat[i - warmup] = t1 - t0;
+                total += t1 - t0;
+            }
+        }
+        if (lines < 0) {
+            fprintf(stderr, "%s: shell stopped answering\n", sc->name);
+            failed = 1;
+            break;
+        }
+
+        if (sc->teardown) run_lines(fd, sc->teardown);
+
+        qsort(lat, (size_t)iters, sizeof(uint64_t), cmp_u64);
+        printf("%-22.22s %9.1f %9.1f %9.1f %9.1f %9.1f %10.0f\n", sc->name,
+               percentile(lat, iters, 0.50) / 1e3,
+               percentile(lat, iters, 0.90) / 1e3,
+               percentile(lat, iters, 0.99) / 1e3,
+               lat[iters - 1] / 1e3,
+               (double)total / iters / 1e3,
+               (double)lines * iters / (total / 1e9));
+    }
+
+    // let the shell exit on its own, then make sure it is gone
+    if (write(fd, "exit\n", 5) != 5) kill(pid, SIGTERM);
+    close(fd);
+    waitpid(pid, NULL, 0);
+    free(lat);
+
+    return failed;
+}
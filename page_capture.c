@@ -0,0 +1,534 @@
+/*
+    page_capture.c
+    Records page-level memory access traces for paging_translator
+
+    Two ways to get a trace out of a real program:
+
+    Sampling a running process (-p PID, or a command to start):
+        ./page_capture [-i ms] [-d secs] [-o file] -p PID
+        ./page_capture [-i ms] [-d secs] [-o file] -- command [args...]
+
+        Every interval the process's mappings (/proc/PID/maps) are read
+        and each page is looked up in /proc/PID/pagemap. The best method
+        the kernel allows is used:
+          idle   idle page tracking (/sys/kernel/mm/page_idle/bitmap,
+                 needs root): every page accessed during the interval
+          dirty  soft-dirty bits (clear_refs 4): pages written during the
+                 interval, plus pages that became resident
+          new    pages that became resident (first touches only)
+        A sample has no order inside it, so each interval's pages come out
+        in address order.
+
+    Tracing a built-in test program (-t PATTERN):
+        ./page_capture [-n pages] [-r refs] [-k window] [-o file] -t seq|random|stride|matrix
+
+        The program's memory is mprotect'ed PROT_NONE and a SIGSEGV handler
+        logs each page it faults on (with the x86 page fault error code
+        telling reads from writes), then opens it: read-only after a read,
+        so a later first write faults once more. Only the last -k pages
+        stay open, so re-references show up again once a page falls out of
+        that window.
+
+    Output is one reference per line in the translator's trace format,
+    "pid:0xaddr" with ":w" for writes, ready for
+        ./paging_translator --trace FILE ...
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <ucontext.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#define PAGEMAP_PRESENT   (1ULL << 63)
+#define PAGEMAP_SOFTDIRTY (1ULL << 55)
+#define PAGEMAP_PFN_MASK  ((1ULL << 55) - 1)
+#define PAGEMAP_CHUNK     65536
+
+enum { METHOD_IDLE, METHOD_DIRTY, METHOD_NEW };
+static const char *g_method_names[] = {"idle", "dirty", "new"};
+
+static long g_page_size;
+static FILE *g_out;
+static uint64_t g_emitted;
+
+static void emit(pid_t pid, uint64_t addr, int write) {
+    fprintf(g_out, "%d:0x%llx%s\n", (int)pid, (unsigned long long)addr, write ? ":w" : "");
+    g_emitted++;
+}
+
+// ---------------- page sets ----------------
+
+// open-addressing set of page addresses; 0 is the empty slot
+typedef struct {
+    uint64_t *slot;
+    size_t cap, count;
+} PageSet;
+
+static void set_init(PageSet *s) {
+    s->cap = 4096;
+    s->count = 0;
+    s->slot = calloc(s->cap, sizeof(uint64_t));
+    if (!s->slot) {
+        perror("calloc");
+        exit(1);
+    }
+}
+
+static void set_clear(PageSet *s) {
+    memset(s->slot, 0, s->cap * sizeof(uint64_t));
+    s->count = 0;
+}
+
+static inline size_t set_hash(uint64_t v) {
+    v *= 0x9E3779B97F4A7C15ULL;
+    return (size_t)(v ^ (v >> 29));
+}
+
+static int set_has(const PageSet *s, uint64_t page) {
+    for (size_t i = set_hash(page) & (s->cap - 1); s->slot[i]; i = (i + 1) & (s->cap - 1)) {
+        if (s->slot[i] == page) return 1;
+    }
+    return 0;
+}
+
+static void set_add(PageSet *s, uint64_t page) {
+    if ((s->count + 1) * 2 > s->cap) {
+        PageSet big = {calloc(s->cap * 2, sizeof(uint64_t)), s->cap * 2, 0};
+        if (!big.slot) {
+            perror("calloc");
+            exit(1);
+        }
+        for (size_t i = 0; i < s->cap; i++) {
+            if (s->slot[i]) set_add(&big, s->slot[i]);
+        }
+        free(s->slot);
+        *s = big;
+    }
+    size_t i = set_hash(page) & (s->cap - 1);
+    while (s->slot[i]) {
+        if (s->slot[i] == page) return;
+        i = (i + 1) & (s->cap - 1);
+    }
+    s->slot[i] = page;
+    s->count++;
+}
+
+// ---------------- sampling ----------------
+
+typedef struct {
+    pid_t pid;
+    int method;
+    int idle_fd;            // page_idle bitmap, -1 unless METHOD_IDLE
+    PageSet present;        // resident at the previous sample
+    PageSet now;
+} Sampler;
+
+static int write_clear_refs(pid_t pid, const char *what) {
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/clear_refs", (int)pid);
+    int fd = open(path, O_WRONLY);
+    if (fd < 0) return -1;
+    int ok = write(fd, what, strlen(what)) == (ssize_t)strlen(what);
+    close(fd);
+    return ok ? 0 : -1;
+}
+
+// does this kernel keep soft-dirty bits? try it on a page of our own
+static int soft_dirty_works(void) {
+    char *p = mmap(NULL, (size_t)g_page_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) return 0;
+    p[0] = 1;
+
+    int works = 0;
+    int fd = open("/proc/self/pagemap", O_RDONLY);
+    if (fd >= 0 && write_clear_refs(getpid(), "4") == 0) {
+        uint64_t e;
+        off_t off = (off_t)((uintptr_t)p / (uintptr_t)g_page_size * sizeof(uint64_t));
+        p[0] = 2;
+        if (pread(fd, &e, sizeof(e), off) == sizeof(e)) works = (e & PAGEMAP_SOFTDIRTY) != 0;
+    }
+    if (fd >= 0) close(fd);
+    munmap(p, (size_t)g_page_size);
+    return works;
+}
+
+static int sampler_open(Sampler *s, pid_t pid) {
+    char path[64];
+    memset(s, 0, sizeof(*s));
+    s->pid = pid;
+    s->idle_fd = -1;
+
+    snprintf(path, sizeof(path), "/proc/%d/pagemap", (int)pid);
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror(path);
+        return -1;
+    }
+    close(fd);
+
+    s->idle_fd = open("/sys/kernel/mm/page_idle/bitmap", O_RDWR);
+    if (s->idle_fd >= 0) s->method = METHOD_IDLE;
+    else if (soft_dirty_works()) s->method = METHOD_DIRTY;
+    else s->method = METHOD_NEW;
+
+    set_init(&s->present);
+    set_init(&s->now);
+    return 0;
+}
+
+static void sampler_close(Sampler *s) {
+    if (s->idle_fd >= 0) close(s->idle_fd);
+    free(s->present.slot);
+    free(s->now.slot);
+}
+
+// idle bitmap: one bit per PFN, read and written in 64-bit words
+static int pfn_idle(int fd, uint64_t pfn) {
+    uint64_t word;
+    if (pread(fd, &word, sizeof(word), (off_t)(pfn / 64 * 8)) != sizeof(word)) return 0;
+    return (word >> (pfn % 64)) & 1;
+}
+
+static void pfn_set_idle(int fd, uint64_t pfn) {
+    uint64_t word = 1ULL << (pfn % 64);
+    if (pwrite(fd, &word, sizeof(word), (off_t)(pfn / 64 * 8)) != sizeof(word)) {
+        // pages the kernel can't track (not on the LRU) are just skipped
+    }
+}
+
+// one pass over every mapping; emits this interval's references
+static int sample(Sampler *s, int first) {
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/maps", (int)s->pid);
+    FILE *maps = fopen(path, "r");
+    if (!maps) return -1;
+
+    // pagemap stays bound to the mm it was opened on, so reopen it each
+    // time in case the process has exec'd since
+    snprintf(path, sizeof(path), "/proc/%d/pagemap", (int)s->pid);
+    int pagemap = open(path, O_RDONLY);
+    if (pagemap < 0) {
+        fclose(maps);
+        return -1;
+    }
+
+    static uint64_t e[PAGEMAP_CHUNK];
+    char line[512];
+    set_clear(&s->now);
+
+    while (fgets(line, sizeof(line), maps)) {
+        unsigned long long start, end;
+        if (sscanf(line, "%llx-%llx", &start, &end) != 2) continue;
+        if (strstr(line, "[vsyscall]")) continue;
+
+        for (uint64_t a = start; a < end; a += (uint64_t)PAGEMAP_CHUNK * (uint64_t)g_page_size) {
+            uint64_t n = (end - a) / (uint64_t)g_page_size;
+            if (n > PAGEMAP_CHUNK) n = PAGEMAP_CHUNK;
+            off_t off = (off_t)(a / (uint64_t)g_page_size * sizeof(uint64_t));
+            ssize_t got = pread(pagemap, e, n * sizeof(uint64_t), off);
+            if (got <= 0) break;
+            n = (uint64_t)got / sizeof(uint64_t);
+
+            for (uint64_t i = 0; i < n; i++) {
+                if (!(e[i] & PAGEMAP_PRESENT)) continue;
+                uint64_t page = a + i * (uint64_t)g_page_size;
+                uint64_t pfn = e[i] & PAGEMAP_PFN_MASK;
+                int is_new = !set_has(&s->present, page);
+                set_add(&s->now, page);
+                if (first) {
+                    if (s->method == METHOD_IDLE && pfn) pfn_set_idle(s->idle_fd, pfn);
+                    continue;
+                }
+
+                if (s->method == METHOD_IDLE && pfn) {
+                    if (is_new || !pfn_idle(s->idle_fd, pfn)) emit(s->pid, page, 0);
+                    pfn_set_idle(s->idle_fd, pfn);
+                } else if (s->method == METHOD_DIRTY && (e[i] & PAGEMAP_SOFTDIRTY)) {
+                    emit(s->pid, page, 1);
+                } else if (is_new) {
+                    emit(s->pid, page, 0);
+                }
+            }
+        }
+    }
+    fclose(maps);
+    close(pagemap);
+
+    // soft_dirty_works() only proved we can clear our own bits; without
+    // the right to clear the target's every page would look dirty forever
+    if (s->method == METHOD_DIRTY && write_clear_refs(s->pid, "4") != 0 && first) {
+        fprintf(stderr, "can't clear soft-dirty bits of pid %d: %s; using method '%s'\n", (int)s->pid,
+                strerror(errno), g_method_names[METHOD_NEW]);
+        s->method = METHOD_NEW;
+    }
+
+    PageSet t = s->present;
+    s->present = s->now;
+    s->now = t;
+    return 0;
+}
+
+static int run_sampler(pid_t pid, pid_t child, int interval_ms, double duration) {
+    Sampler s;
+    if (sampler_open(&s, pid) != 0) return 1;
+    fprintf(stderr, "sampling pid %d every %d ms with method '%s'\n", (int)pid, interval_ms,
+            g_method_names[s.method]);
+
+    struct timespec t0, now, gap = {interval_ms / 1000, (long)(interval_ms % 1000) * 1000000L};
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    int samples = 0;
+
+    for (int first = 1;; first = 0) {
+        if (sample(&s, first) != 0) break;     // process is gone
+        samples++;
+
+        if (child > 0 && waitpid(child, NULL, WNOHANG) == child) {
+            child = 0;
+            break;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        double elapsed = (double)(now.tv_sec - t0.tv_sec) + (double)(now.tv_nsec - t0.tv_nsec) / 1e9;
+        if (duration > 0 && elapsed >= duration) break;
+        nanosleep(&gap, NULL);
+    }
+
+    if (child > 0) {
+        kill(child, SIGTERM);
+        waitpid(child, NULL, 0);
+    }
+    sampler_close(&s);
+    fprintf(stderr, "%d samples, %llu references\n", samples, (unsigned long long)g_emitted);
+    return 0;
+}
+
+// ---------------- mprotect tracing ----------------
+
+typedef struct {
+    uint64_t addr;
+    int write;
+} TraceRec;
+
+static char *g_region;
+static size_t g_region_pages;
+static TraceRec *g_log;
+static size_t g_log_n, g_log_cap;
+static size_t *g_window;        // open pages, oldest first (ring)
+static size_t g_window_k, g_window_n, g_window_head;
+static unsigned char *g_open;   // page is in the window
+
+// async-signal-safe: only preallocated memory and mprotect
+static void segv_handler(int sig, siginfo_t *si, void *ctx) {
+    char *p = si->si_addr;
+    if (p < g_region || p >= g_region + g_region_pages * (size_t)g_page_size) {
+        signal(sig, SIG_DFL);
+        return;
+    }
+
+    size_t page = (size_t)(p - g_region) / (size_t)g_page_size;
+    int write = 0;
+#if defined(__x86_64__)
+    // bit 1 of the page fault error code: the access was a write
+    write = (((ucontext_t *)ctx)->uc_mcontext.gregs[REG_ERR] & 2) != 0;
+#else
+    (void)ctx;
+#endif
+
+    if (g_log_n < g_log_cap) {
+        g_log[g_log_n].addr = (uint64_t)(uintptr_t)(g_region + page * (size_t)g_page_size);
+        g_log[g_log_n].write = write;
+        g_log_n++;
+    }
+
+    // a write to a page that is open read-only: upgrade it in place
+    if (write && g_open[page]) {
+        mprotect(g_region + page * (size_t)g_page_size, (size_t)g_page_size, PROT_READ | PROT_WRITE);
+        return;
+    }
+
+    // close the oldest open page once the window is full
+    if (g_window_n == g_window_k) {
+        size_t old = g_window[g_window_head];
+        mprotect(g_region + old * (size_t)g_page_size, (size_t)g_page_size, PROT_NONE);
+        g_open[old] = 0;
+        g_window_head = (g_window_head + 1) % g_window_k;
+        g_window_n--;
+    }
+    g_window[(g_window_head + g_window_n) % g_window_k] = page;
+    g_window_n++;
+    g_open[page] = 1;
+    mprotect(g_region + page * (size_t)g_page_size, (size_t)g_page_size,
+             write ? PROT_READ | PROT_WRITE : PROT_READ);
+}
+
+static uint64_t g_rng = 0x9E3779B97F4A7C15ULL;
+
+static inline uint64_t xorshift64(void) {
+    g_rng ^= g_rng << 13;
+    g_rng ^= g_rng >> 7;
+    g_rng ^= g_rng << 17;
+    return g_rng;
+}
+
+// the test programs; volatile so every access really happens
+static void workload(const char *pattern, size_t refs) {
+    volatile long *mem = (volatile long *)g_region;
+    size_t words = g_region_pages * (size_t)g_page_size / sizeof(long);
+
+    if (strcmp(pattern, "seq") == 0) {
+        for (size_t i = 0; i < refs; i++) mem[i % words] += 1;
+    } else if (strcmp(pattern, "random") == 0) {
+        for (size_t i = 0; i < refs; i++) mem[xorshift64() % words] += 1;
+    } else if (strcmp(pattern, "stride") == 0) {
+        // one word per page, round and round
+        size_t step = (size_t)g_page_size / sizeof(long);
+        for (size_t i = 0; i < refs; i++) mem[(i * step) % words] += 1;
+    } else {
+        // naive n x n matrix multiply: c = a * b, b walked by column
+        size_t n = 1;
+        while ((n + 1) * (n + 1) * 3 <= words) n++;
+        volatile long *a = mem, *b = mem + n * n, *c = mem + 2 * n * n;
+        size_t done = 0;
+        for (size_t i = 0; i < n && done < refs; i++) {
+            for (size_t j = 0; j < n && done < refs; j++) {
+                long sum = 0;
+                for (size_t k = 0; k < n; k++) sum += a[i * n + k] * b[k * n + j];
+                c[i * n + j] = sum;
+                done += 2 * n + 1;
+            }
+        }
+    }
+}
+
+static int run_tracer(const char *pattern, size_t pages, size_t refs, size_t window) {
+    g_region_pages = pages;
+    g_region = mmap(NULL, pages * (size_t)g_page_size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    g_log_cap = 2 * refs + pages;     // a read fault and a write fault per access at worst
+    g_log = malloc(g_log_cap * sizeof(TraceRec));
+    g_window_k = window;
+    g_window = malloc(window * sizeof(size_t));
+    g_open = calloc(pages, 1);
+    if (g_region == MAP_FAILED || !g_log || !g_window || !g_open) {
+        perror("allocating the traced region");
+        return 1;
+    }
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_sigaction = segv_handler;
+    sa.sa_flags = SA_SIGINFO;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGSEGV, &sa, NULL);
+
+    workload(pattern, refs);
+
+    signal(SIGSEGV, SIG_DFL);
+    for (size_t i = 0; i < g_log_n; i++) emit(getpid(), g_log[i].addr, g_log[i].write);
+    fprintf(stderr, "%s: %zu pages, window %zu, %llu references%s\n", pattern, pages, window,
+            (unsigned long long)g_emitted, g_log_n == g_log_cap ? " (log full)" : "");
+
+    munmap(g_region, pages * (size_t)g_page_size);
+    free(g_log);
+    free(g_window);
+    free(g_open);
+    return 0;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [-i ms] [-d secs] [-o file] -p PID\n"
+            "       %s [-i ms] [-d secs] [-o file] -- command [args...]\n"
+            "       %s [-n pages] [-r refs] [-k window] [-o file] -t seq|random|stride|matrix\n",
+            prog, prog, prog);
+}
+
+int main(int argc, char *argv[]) {
+    const char *out_path = NULL;
+    const char *pattern = NULL;
+    pid_t pid = 0;
+    int interval_ms = 100;
+    double duration = 0;
+    size_t pages = 256, refs = 1000000, window = 8;
+    int opt;
+
+    g_page_size = sysconf(_SC_PAGESIZE);
+
+    while ((opt = getopt(argc, argv, "+p:i:d:o:t:n:r:k:h")) != -1) {
+        switch (opt) {
+        case 'p': pid = (pid_t)atoi(optarg); break;
+        case 'i': interval_ms = atoi(optarg); break;
+        case 'd': duration = atof(optarg); break;
+        case 'o': out_path = optarg; break;
+        case 't': pattern = optarg; break;
+        case 'n': pages = strtoull(optarg, NULL, 0); break;
+        case 'r': refs = strtoull(optarg, NULL, 0); break;
+        case 'k': window = strtoull(optarg, NULL, 0); break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+
+    int have_cmd = optind < argc;
+    if ((pid > 0) + have_cmd + (pattern != NULL) != 1 || interval_ms <= 0 || !pages || !window) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (pattern && strcmp(pattern, "seq") && strcmp(pattern, "random") &&
+        strcmp(pattern, "stride") && strcmp(pattern, "matrix")) {
+        fprintf(stderr, "unknown pattern: %s\n", pattern);
+        return 1;
+    }
+
+    g_out = stdout;
+    if (out_path && !(g_out = fopen(out_path, "w"))) {
+        perror(out_path);
+        return 1;
+    }
+    setvbuf(g_out, NULL, _IOFBF, 1 << 20);
+
+    int rc;
+    if (pattern) {
+        rc = run_tracer(pattern, pages, refs, window);
+    } else if (pid > 0) {
+        rc = run_sampler(pid, 0, interval_ms, duration);
+    } else {
+        // wait for the exec (the close-on-exec pipe closes) so the first
+        // sample is of the command and not of our own forked copy
+        int sync[2];
+        if (pipe2(sync, O_CLOEXEC) != 0) {
+            perror("pipe failed");
+            return 1;
+        }
+        pid_t child = fork();
+        if (child < 0) {
+            perror("fork failed");
+            return 1;
+        }
+        if (child == 0) {
+            close(sync[0]);
+            execvp(argv[optind], &argv[optind]);
+            perror("execvp failed");
+            _exit(127);
+        }
+        close(sync[1]);
+        char c;
+        while (read(sync[0], &c, 1) < 0 && errno == EINTR) {}
+        close(sync[0]);
+        rc = run_sampler(child, child, interval_ms, duration);
+    }
+
+    if (fclose(g_out) != 0) {
+        perror("writing trace");
+        return 1;
+    }
+    return rc;
+}
@@ -4,14 +4,3942 @@
 
     Simple program that translates logical addresses into physical addresses
     using paging. Page size is 1024 bytes and the page table is predefined.
+
+    Run with no arguments for the original quiz behaviour. With options it
+    becomes a paging simulator:
+
+        --preset x86-32|x86-64|x86-64-5   common page table shapes
+        --page-size SIZE                  page size in bytes (K/M/G suffix ok)
+        --va-bits N                       virtual address width
+        --levels N                        levels, bits split evenly
+        --bits a,b,...                    index bits per level, top first
+        --pte-size N                      bytes per page table entry
+        -q, --quiet                       summary only, no per-address lines
+        --tlb E[:W[:POLICY]]              L1 TLB: entries, ways, lru|fifo|random
+        --tlb2 E[:W[:POLICY]]             L2 TLB behind it
+        --asid                            tag TLB entries with the pid
+        --tlb-cycles L1,L2                TLB hit latencies (default 1,7)
+        --walk-cycles N                   cycles per page walk reference (30)
+        --frames N                        physical frames; pages get evicted
+        --policy LIST|all                 fifo,lru,clock,opt,wsclock (lru)
+        --ws-tau N                        WSClock working set window (1000)
+        --trace FILE                      mmap a trace file instead of stdin
+        --format text|bin|ref             text, raw 64-bit addresses, or
+                                          16-byte {addr, pid, flags} records
+        --kernel scalar|avx2|avx512       batch kernel (default: best by CPUID)
+        --kernel-bench PAGES              time the batch kernels and exit
+        --threads N                       replay --trace on N worker threads
+        --shard chunk|pid                 split by trace chunk (stateless
+                                          translation) or by process, each
+                                          thread getting a share of --frames
+        --table radix|hashed|inverted     page table structure (radix)
+        --huge SIZE,...                   also map huge pages, e.g. 2M,1G
+        --promote eager|PERCENT           huge page as soon as a region is
+                                          empty, or collapse at PERCENT mapped
+        --analyze                         reuse distances, LRU faults for every
+                                          memory size and working set sizes
+        --cache SIZE:WAYS[:LINE]          add a data cache level fed physical
+                                          addresses (repeat for L2, L3)
+        --cache-mode nine|inclusive|exclusive
+                                          how the levels share lines (nine)
+        --buddy SIZE                      allocate frames from a buddy allocator
+                                          over SIZE of physical memory
+        --slab                            page table memory from slab caches
+                                          on top of it
+
+    Addresses (decimal or 0x hex, optionally "pid:addr", with an optional
+    ":r" or ":w" suffix) are read from stdin until EOF. Each pid gets its
+    own page table; without --asid a change of pid flushes the TLBs.
+    "fork:PARENT:CHILD" and "exit:PID" tokens fork and end processes: the
+    child shares the parent's frames copy-on-write, frames are reference
+    counted, and the summary shows COW faults and the frames sharing
+    saved. Pages are mapped on first touch and the page table is a sparse
+    radix tree, so the summary shows what a realistic address space costs
+    in table memory and memory references per walk.
+
+    With --frames memory is limited and a fault evicts a page chosen by
+    the replacement policy. Listing several policies replays the same trace
+    once per policy and prints a fault comparison; OPT uses a precomputed
+    next-use index so it stays O(log frames) per reference.
+
+    --huge lets leaves sit above the last level (2 MiB / 1 GiB pages on
+    x86-64), promoted eagerly or once a share of the region is mapped; the
+    summary shows TLB reach and table memory saved.
+
+    --cache chains write-back LRU caches after translation, so frame
+    placement shows up as per-level miss rates; the summary also gives the
+    number of page colors each level has.
+
+    --buddy reports allocation cost (splits and merges), free blocks per
+    order and the unusable free space index at every huge page size; with
+    --huge, sizes the fragmented allocator can't supply fall back to
+    smaller pages.
+
+    --analyze replaces translation with a one-pass locality report: the
+    LRU stack distance histogram (O(log n) per reference), the LRU fault
+    curve it implies for every frame count, and the mean and peak working
+    set over windows of 64, 256, ... references and --ws-tau.
+
+    --trace maps the file and translates it in batches; per-address output
+    is the compact "[pid:]logical physical[ F|C]" through one large buffer,
+    and -q skips it for aggregate stats only.
 */
 
-#include <stdio.h>
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <getopt.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#define PAGE_SIZE 1024
+#define NUM_PAGES 4
+
+#define MAX_LEVELS 6
+
+// ---------------- configuration ----------------
+
+// TLB replacement policies
+enum { REPL_LRU, REPL_FIFO, REPL_RANDOM };
+
+// page table structures
+enum { TABLE_RADIX, TABLE_HASHED, TABLE_INVERTED };
+
+// page replacement policies for --frames
+enum { POL_FIFO, POL_LRU, POL_CLOCK, POL_OPT, POL_WSCLOCK, NUM_POLICIES };
+
+static const char *g_policy_names[NUM_POLICIES] = {"fifo", "lru", "clock", "opt", "wsclock"};
+
+typedef struct {
+    int entries;
+    int ways;                   // entries == ways means fully associative
+    int policy;
+} TlbSpec;
+
+// data caches behind translation, L1 first
+#define MAX_CACHES 3
+enum { CACHE_NINE, CACHE_INCLUSIVE, CACHE_EXCLUSIVE };
+static const char *g_cache_modes[] = {"non-inclusive", "inclusive", "exclusive"};
+
+typedef struct {
+    uint64_t size;
+    int ways;
+    int line;                   // bytes, the same at every level
+} CacheSpec;
+
+typedef struct {
+    int page_shift;             // log2(page size)
+    int va_bits;                // page_shift + sum(bits)
+    int levels;
+    int bits[MAX_LEVELS];       // index bits per level, top level first
+    int pte_size;               // bytes per entry, for memory cost
+    int quiet;
+
+    int ntlb;                   // 0, 1 (L1) or 2 (L1 + L2)
+    TlbSpec tlb[2];
+    int asid;                   // tag TLB entries instead of flushing on a switch
+    int tlb_cycles[2];          // hit latency of each TLB level
+    int walk_cycles;            // cost of one page table memory reference
+
+    uint64_t frames;            // physical frames, 0 = unlimited
+    int policy;                 // replacement policy of this run
+    int policies[NUM_POLICIES]; // policies to compare on the same trace
+    int npolicies;
+    uint64_t ws_tau;            // WSClock working set window, in references
+
+    const char *trace_path;     // --trace: mapped trace file instead of stdin
+    int trace_format;           // FMT_TEXT, FMT_BIN or FMT_REF
+    const char *kernel;         // batch kernel by name, NULL = best for this CPU
+    int threads;                // parallel replay of --trace
+    int shard;                  // SHARD_CHUNK or SHARD_PID
+    int table;                  // TABLE_RADIX, TABLE_HASHED or TABLE_INVERTED
+    uint32_t huge_levels;       // levels above the last that may hold leaves
+    int promote_pct;            // 0 = eager, else collapse at this % mapped
+    int ncache;                 // data cache levels fed physical addresses
+    CacheSpec cache[MAX_CACHES];
+    int cache_mode;             // CACHE_NINE, CACHE_INCLUSIVE or CACHE_EXCLUSIVE
+    uint64_t buddy_frames;      // --buddy: physical memory in frames, 0 = bump
+    int slab;                   // page table memory comes from slab caches
+} Config;
+
+// parse "ENTRIES[:WAYS[:lru|fifo|random]]"
+static int parse_tlb(const char *s, TlbSpec *t) {
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%s", s);
+
+    char *f = strtok(buf, ":");
+    t->entries = f ? atoi(f) : 0;
+    f = strtok(NULL, ":");
+    t->ways = f ? atoi(f) : t->entries;
+    f = strtok(NULL, ":");
+    t->policy = REPL_LRU;
+    if (f) {
+        if (strcmp(f, "fifo") == 0) t->policy = REPL_FIFO;
+        else if (strcmp(f, "random") == 0) t->policy = REPL_RANDOM;
+        else if (strcmp(f, "lru") != 0) return -1;
+    }
+    if (t->entries <= 0 || t->ways <= 0 || t->entries % t->ways) return -1;
+    return 0;
+}
+
+// "fifo,lru,..." or "all"
+static int parse_policies(char *s, Config *cfg) {
+    cfg->npolicies = 0;
+    if (strcmp(s, "all") == 0) {
+        for (int p = 0; p < NUM_POLICIES; p++) cfg->policies[cfg->npolicies++] = p;
+        return 0;
+    }
+    for (char *tok = strtok(s, ","); tok; tok = strtok(NULL, ",")) {
+        int p = 0;
+        while (p < NUM_POLICIES && strcmp(tok, g_policy_names[p]) != 0) p++;
+        if (p == NUM_POLICIES || cfg->npolicies == NUM_POLICIES) return -1;
+        cfg->policies[cfg->npolicies++] = p;
+    }
+    return cfg->npolicies ? 0 : -1;
+}
+
+// parse "4096", "4K", "2M", "1G"
+static int parse_size(const char *s, uint64_t *out) {
+    char *end;
+    unsigned long long v = strtoull(s, &end, 0);
+    if (end == s) return -1;
+
+    switch (*end) {
+    case 'k': case 'K': v <<= 10; end++; break;
+    case 'm': case 'M': v <<= 20; end++; break;
+    case 'g': case 'G': v <<= 30; end++; break;
+    }
+    if (*end == 'B' || *end == 'b') end++;
+    if (*end) return -1;
+
+    *out = v;
+    return 0;
+}
+
+static int log2_exact(uint64_t v) {
+    if (v == 0 || (v & (v - 1))) return -1;
+    int n = 0;
+    while (v > 1) {
+        v >>= 1;
+        n++;
+    }
+    return n;
+}
+
+// parse "SIZE:WAYS[:LINE]", line 64 bytes by default
+static int parse_cache(const char *s, CacheSpec *c) {
+    char buf[64];
+    uint64_t line = 64;
+    snprintf(buf, sizeof(buf), "%s", s);
+
+    char *f = strtok(buf, ":");
+    if (!f || parse_size(f, &c->size) != 0) return -1;
+    f = strtok(NULL, ":");
+    c->ways = f ? atoi(f) : 0;
+    f = strtok(NULL, ":");
+    if (f && parse_size(f, &line) != 0) return -1;
+    if (c->ways <= 0 || log2_exact(line) < 0 || line > 4096) return -1;
+    c->line = (int)line;
+    if (c->size == 0 || c->size % ((uint64_t)c->ways * line)) return -1;
+    return 0;
+}
+
+static int apply_preset(Config *cfg, const char *name) {
+    if (strcmp(name, "x86-32") == 0) {
+        cfg->page_shift = 12;
+        cfg->levels = 2;
+        cfg->bits[0] = 10;
+        cfg->bits[1] = 10;
+        cfg->pte_size = 4;
+    } else if (strcmp(name, "x86-64") == 0 || strcmp(name, "x86-64-5") == 0) {
+        cfg->page_shift = 12;
+        cfg->levels = (name[6] == '-') ? 5 : 4;
+        for (int i = 0; i < cfg->levels; i++) cfg->bits[i] = 9;
+        cfg->pte_size = 8;
+    } else {
+        return -1;
+    }
+    cfg->va_bits = cfg->page_shift;
+    for (int i = 0; i < cfg->levels; i++) cfg->va_bits += cfg->bits[i];
+    return 0;
+}
+
+// "2M,1G": each size must be what one entry of some level maps
+static int parse_huge(char *list, Config *cfg) {
+    for (char *tok = strtok(list, ","); tok; tok = strtok(NULL, ",")) {
+        uint64_t size;
+        int bits = (parse_size(tok, &size) == 0) ? log2_exact(size) : -1;
+        int order = bits - cfg->page_shift, level = -1, o = 0;
+
+        for (int l = cfg->levels - 1; l > 0; l--) {
+            o += cfg->bits[l];
+            if (o == order) level = l - 1;
+        }
+        if (level < 0) {
+            fprintf(stderr, "%s isn't a page size of this table; sizes are", tok);
+            o = 0;
+            for (int l = cfg->levels - 1; l > 0; l--) {
+                o += cfg->bits[l];
+                int b = cfg->page_shift + o, u = b >= 40 ? 4 : b / 10;
+                fprintf(stderr, " %llu%c", 1ULL << (b - 10 * u), " KMGT"[u]);
+            }
+            fprintf(stderr, "\n");
+            return -1;
+        }
+        cfg->huge_levels |= 1U << level;
+    }
+    return 0;
+}
+
+// fill in levels/bits from whatever was given; -1 with a message if it
+// doesn't add up
+static int finish_config(Config *cfg, int levels_set, int bits_set, int va_set) {
+    int index_bits = cfg->va_bits - cfg->page_shift;
+
+    if (bits_set) {
+        int sum = 0;
+        for (int i = 0; i < cfg->levels; i++) sum += cfg->bits[i];
+        if (va_set && sum != index_bits) {
+            fprintf(stderr, "bits per level add up to %d, but va-bits - page bits is %d\n",
+                    sum, index_bits);
+            return -1;
+        }
+        cfg->va_bits = cfg->page_shift + sum;
+    } else if (levels_set || va_set) {
+        if (index_bits <= 0) {
+            fprintf(stderr, "va-bits must be larger than the page offset (%d bits)\n", cfg->page_shift);
+            return -1;
+        }
+        // split evenly, the top level takes the remainder like x86 PAE/LA57
+        int each = index_bits / cfg->levels;
+        for (int i = 0; i < cfg->levels; i++) cfg->bits[i] = each;
+        cfg->bits[0] += index_bits - each * cfg->levels;
+    }
+
+    if (cfg->va_bits > 64) {
+        fprintf(stderr, "virtual address space is %d bits, max is 64\n", cfg->va_bits);
+        return -1;
+    }
+    for (int i = 0; i < cfg->levels; i++) {
+        if (cfg->bits[i] < 1 || cfg->bits[i] > 20) {
+            fprintf(stderr, "level %d has %d index bits (1..20 allowed)\n", i + 1, cfg->bits[i]);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// ---------------- physical memory ----------------
+
+// --buddy SIZE hands out frames from a binary buddy allocator over SIZE
+// of physical memory instead of counting up from 0. Process exits,
+// mappings dropped by copy-on-write and huge page collapses free them.
+// Free blocks of each order sit on a list threaded through per-frame
+// links; a free merges with its buddy (block ^ 2^order) for as long as
+// that is free and the same order.
+//
+// --slab also takes page table memory from it: every node size gets a
+// slab cache whose slabs are buddy blocks, so partly used slabs show up
+// as internal fragmentation of page table memory.
+
+#define BUDDY_ORDERS 40
+#define NO_FRAME     UINT64_MAX
+#define NO_LINK      UINT32_MAX
+#define MAX_SLAB_CACHES 8
+
+typedef struct {
+    uint64_t nframes;
+    int max_order;
+    uint32_t *next, *prev;          // free list links, by first frame
+    int8_t *free_order;             // order of the free block starting here, -1 if none
+    uint32_t head[BUDDY_ORDERS];
+    uint64_t blocks[BUDDY_ORDERS];  // free blocks per order
+    uint64_t free_frames;
+    uint64_t allocs, frees, failed;
+    uint64_t splits, merges, max_splits;
+} Buddy;
+
+typedef struct {
+    uint64_t frame;
+    uint32_t inuse;
+    uint32_t prev, next;            // partial slab list
+} Slab;
+
+typedef struct {
+    uint32_t size;                  // object bytes
+    uint32_t per_slab;
+    int order;                      // slab = 2^order frames
+    Slab *slabs;
+    uint32_t nslabs, cap;
+    uint32_t partial;               // slabs with a free object
+    uint32_t unused;                // recycled Slab entries, chained by next
+    uint64_t objects, live_slabs;
+} SlabCache;
+
+typedef struct PhysMem {
+    Buddy buddy;
+    int page_shift;
+    SlabCache cache[MAX_SLAB_CACHES];
+    int ncaches;
+} PhysMem;
+
+static void buddy_push(Buddy *b, uint64_t f, int order) {
+    b->free_order[f] = (int8_t)order;
+    b->prev[f] = NO_LINK;
+    b->next[f] = b->head[order];
+    if (b->head[order] != NO_LINK) b->prev[b->head[order]] = (uint32_t)f;
+    b->head[order] = (uint32_t)f;
+    b->blocks[order]++;
+}
+
+static void buddy_unlink(Buddy *b, uint64_t f) {
+    int order = b->free_order[f];
+    if (b->prev[f] != NO_LINK) b->next[b->prev[f]] = b->next[f];
+    else b->head[order] = b->next[f];
+    if (b->next[f] != NO_LINK) b->prev[b->next[f]] = b->prev[f];
+    b->free_order[f] = -1;
+    b->blocks[order]--;
+}
+
+static void buddy_init(Buddy *b, uint64_t nframes) {
+    memset(b, 0, sizeof(*b));
+    b->nframes = nframes;
+    b->next = malloc(nframes * sizeof(uint32_t));
+    b->prev = malloc(nframes * sizeof(uint32_t));
+    b->free_order = malloc(nframes);
+    if (!b->next || !b->prev || !b->free_order) {
+        perror("malloc");
+        exit(1);
+    }
+    memset(b->free_order, -1, nframes);
+    for (int o = 0; o < BUDDY_ORDERS; o++) b->head[o] = NO_LINK;
+    while (b->max_order + 1 < BUDDY_ORDERS && (2ULL << b->max_order) <= nframes) b->max_order++;
+
+    // memory that isn't a power of two: the largest aligned blocks that fit
+    for (uint64_t f = 0; f < nframes;) {
+        int o = b->max_order;
+        while (o > 0 && ((f & ((1ULL << o) - 1)) || f + (1ULL << o) > nframes)) o--;
+        buddy_push(b, f, o);
+        f += 1ULL << o;
+    }
+    b->free_frames = nframes;
+}
+
+static void buddy_destroy(Buddy *b) {
+    free(b->next);
+    free(b->prev);
+    free(b->free_order);
+}
+
+// first frame of a 2^order block, or NO_FRAME
+static uint64_t buddy_alloc(Buddy *b, int order) {
+    int o = order;
+    while (o <= b->max_order && b->head[o] == NO_LINK) o++;
+    if (o > b->max_order) {
+        b->failed++;
+        return NO_FRAME;
+    }
+
+    uint64_t f = b->head[o];
+    buddy_unlink(b, f);
+    uint64_t splits = (uint64_t)(o - order);
+    while (o > order) {
+        o--;
+        buddy_push(b, f + (1ULL << o), o);
+    }
+    b->allocs++;
+    b->splits += splits;
+    if (splits > b->max_splits) b->max_splits = splits;
+    b->free_frames -= 1ULL << order;
+    return f;
+}
+
+static void buddy_free(Buddy *b, uint64_t f, int order) {
+    b->frees++;
+    b->free_frames += 1ULL << order;
+    while (order < b->max_order) {
+        uint64_t buddy = f ^ (1ULL << order);
+        if (buddy >= b->nframes || b->free_order[buddy] != order) break;
+        buddy_unlink(b, buddy);
+        f &= ~(1ULL << order);
+        order++;
+        b->merges++;
+    }
+    buddy_push(b, f, order);
+}
+
+// share of free memory that can't serve a 2^order allocation
+static double buddy_unusable(const Buddy *b, int order) {
+    if (!b->free_frames) return 0.0;
+    uint64_t usable = 0;
+    for (int o = order; o <= b->max_order; o++) usable += b->blocks[o] << o;
+    return (double)(b->free_frames - usable) / (double)b->free_frames;
+}
+
+static uint64_t mem_alloc(PhysMem *m, int order, const char *what) {
+    uint64_t f = buddy_alloc(&m->buddy, order);
+    if (f == NO_FRAME) {
+        fprintf(stderr, "out of physical memory: no free order-%d block for %s "
+                        "(%llu of %llu frames free)\n", order, what,
+                (unsigned long long)m->buddy.free_frames, (unsigned long long)m->buddy.nframes);
+        exit(1);
+    }
+    return f;
+}
+
+static SlabCache *slab_cache(PhysMem *m, uint32_t size) {
+    for (int i = 0; i < m->ncaches; i++) {
+        if (m->cache[i].size == size) return &m->cache[i];
+    }
+    if (m->ncaches == MAX_SLAB_CACHES) {
+        fprintf(stderr, "too many slab caches\n");
+        exit(1);
+    }
+
+    // smallest slab that fits an object and wastes at most an eighth
+    SlabCache *c = &m->cache[m->ncaches++];
+    memset(c, 0, sizeof(*c));
+    c->size = size;
+    uint64_t page = 1ULL << m->page_shift;
+    while ((page << c->order) < size ||
+           (c->order < 3 && (page << c->order) % size > (page << c->order) / 8)) {
+        c->order++;
+    }
+    c->per_slab = (uint32_t)((page << c->order) / size);
+    c->partial = c->unused = NO_LINK;
+    return c;
+}
+
+static void slab_unlink(SlabCache *c, uint32_t i) {
+    Slab *sl = &c->slabs[i];
+    if (sl->prev != NO_LINK) c->slabs[sl->prev].next = sl->next;
+    else c->partial = sl->next;
+    if (sl->next != NO_LINK) c->slabs[sl->next].prev = sl->prev;
+}
+
+static void slab_push(SlabCache *c, uint32_t i) {
+    c->slabs[i].prev = NO_LINK;
+    c->slabs[i].next = c->partial;
+    if (c->partial != NO_LINK) c->slabs[c->partial].prev = i;
+    c->partial = i;
+}
+
+// one object; returns a handle (cache index << 32 | slab) for slab_free
+static uint64_t slab_alloc(PhysMem *m, uint32_t size) {
+    SlabCache *c = slab_cache(m, size);
+    uint32_t i = c->partial;
+
+    if (i == NO_LINK) {
+        if (c->unused != NO_LINK) {
+            i = c->unused;
+            c->unused = c->slabs[i].next;
+        } else {
+            if (c->nslabs == c->cap) {
+                c->cap = c->cap ? c->cap * 2 : 64;
+                Slab *ns = realloc(c->slabs, c->cap * sizeof(Slab));
+                if (!ns) {
+                    perror("realloc");
+                    exit(1);
+                }
+                c->slabs = ns;
+            }
+            i = c->nslabs++;
+        }
+        c->slabs[i].frame = mem_alloc(m, c->order, "a page table slab");
+        c->slabs[i].inuse = 0;
+        c->live_slabs++;
+        slab_push(c, i);
+    }
+
+    if (++c->slabs[i].inuse == c->per_slab) slab_unlink(c, i);
+    c->objects++;
+    return (uint64_t)(c - m->cache) << 32 | i;
+}
+
+// empty slabs go straight back to the buddy allocator
+static void slab_free(PhysMem *m, uint64_t handle) {
+    SlabCache *c = &m->cache[handle >> 32];
+    uint32_t i = (uint32_t)handle;
+    Slab *sl = &c->slabs[i];
+
+    if (sl->inuse-- == c->per_slab) slab_push(c, i);
+    c->objects--;
+    if (sl->inuse == 0) {
+        slab_unlink(c, i);
+        buddy_free(&m->buddy, sl->frame, c->order);
+        c->live_slabs--;
+        sl->next = c->unused;
+        c->unused = i;
+    }
+}
+
+// ---------------- radix page table ----------------
+
+// a page table entry: either a leaf (frame number + flags) or, with
+// PTE_TABLE set, a pointer to the next level node
+#define PTE_PRESENT     0x1ULL
+#define PTE_TABLE       0x2ULL
+#define PTE_HUGE        0x4ULL      // leaf above the last level
+#define PTE_COW         0x8ULL      // frame shared since a fork, read-only
+#define PTE_FRAME_SHIFT 12
+
+// node pointers are at least 16-byte aligned, leaving the low bits for flags
+#define PTE_NODE(e)     ((uint64_t *)(uintptr_t)((e) & ~0xFULL))
+
+typedef struct {
+    Config cfg;
+    uint64_t *root;
+    uint64_t nodes[MAX_LEVELS];     // allocated nodes per level
+    uint64_t mapped;
+    PhysMem *mem;                   // --slab: nodes also take slab objects
+} RadixTable;
+
+// with --slab a node carries its slab handle one slot past the entries
+static uint64_t *node_alloc(RadixTable *pt, int level) {
+    size_t n = (size_t)1 << pt->cfg.bits[level];
+    uint64_t *node = calloc(n + (pt->mem != NULL), sizeof(uint64_t));
+    if (!node) {
+        perror("calloc");
+        exit(1);
+    }
+    if (pt->mem) node[n] = slab_alloc(pt->mem, (uint32_t)(n * (size_t)pt->cfg.pte_size));
+    pt->nodes[level]++;
+    return node;
+}
+
+static void node_release(const RadixTable *pt, uint64_t *node, int level) {
+    if (pt->mem) slab_free(pt->mem, node[(size_t)1 << pt->cfg.bits[level]]);
+    free(node);
+}
+
+static void radix_init(RadixTable *pt, const Config *cfg, PhysMem *mem) {
+    memset(pt, 0, sizeof(*pt));
+    pt->cfg = *cfg;
+    pt->mem = mem;
+    pt->root = node_alloc(pt, 0);
+}
+
+static void node_free(const RadixTable *pt, uint64_t *node, int level) {
+    if (level + 1 < pt->cfg.levels) {
+        size_t n = (size_t)1 << pt->cfg.bits[level];
+        for (size_t i = 0; i < n; i++) {
+            if (node[i] & PTE_TABLE) node_free(pt, PTE_NODE(node[i]), level + 1);
+        }
+    }
+    node_release(pt, node, level);
+}
+
+static void radix_destroy(RadixTable *pt) {
+    node_free(pt, pt->root, 0);
+    pt->root = NULL;
+}
+
+// index into the node at level for this virtual page number
+static inline size_t radix_index(const Config *cfg, uint64_t vpn, int level) {
+    int shift = 0;
+    for (int l = cfg->levels - 1; l > level; l--) shift += cfg->bits[l];
+    return (size_t)((vpn >> shift) & ((1ULL << cfg->bits[level]) - 1));
+}
+
+// walk to the leaf PTE for vpn. With create, missing nodes are allocated.
+// *refs counts page table memory references made by the walk.
+static uint64_t *radix_walk(RadixTable *pt, uint64_t vpn, int create, int *refs) {
+    uint64_t *node = pt->root;
+    int r = 0;
+
+    for (int level = 0; level < pt->cfg.levels; level++) {
+        uint64_t *e = &node[radix_index(&pt->cfg, vpn, level)];
+        r++;
+
+        if (level == pt->cfg.levels - 1) {
+            if (refs) *refs = r;
+            return e;
+        }
+
+        if (!(*e & PTE_TABLE)) {
+            if (!create) {
+                if (refs) *refs = r;
+                return NULL;
+            }
+            *e = (uint64_t)(uintptr_t)node_alloc(pt, level + 1) | PTE_TABLE | PTE_PRESENT;
+        }
+        node = PTE_NODE(*e);
+    }
+    return NULL;
+}
+
+// log2 of the base pages one entry at this level maps
+static int level_order(const Config *cfg, int level) {
+    int o = 0;
+    for (int l = level + 1; l < cfg->levels; l++) o += cfg->bits[l];
+    return o;
+}
+
+// walk towards vpn's entry at level stop, ending early at a huge leaf;
+// *level is where it ended. Without create a missing node ends the walk
+// at the empty entry that would point to it.
+static uint64_t *radix_walk_to(RadixTable *pt, uint64_t vpn, int stop, int create, int *refs, int *level) {
+    uint64_t *node = pt->root;
+
+    for (int l = 0;; l++) {
+        uint64_t *e = &node[radix_index(&pt->cfg, vpn, l)];
+        if (refs) *refs = l + 1;
+        if (l == stop || (!(*e & PTE_TABLE) && ((*e & PTE_PRESENT) || !create))) {
+            *level = l;
+            return e;
+        }
+        if (!(*e & PTE_TABLE)) {
+            *e = (uint64_t)(uintptr_t)node_alloc(pt, l + 1) | PTE_TABLE | PTE_PRESENT;
+        }
+        node = PTE_NODE(*e);
+    }
+}
+
+// call fn on every present last-level leaf under node
+typedef void (*LeafFn)(void *ctx, uint64_t vpn, uint64_t *pte);
+
+static void radix_leaves(const RadixTable *pt, uint64_t *node, int level, uint64_t prefix, LeafFn fn, void *ctx) {
+    size_t n = (size_t)1 << pt->cfg.bits[level];
+    for (size_t i = 0; i < n; i++) {
+        uint64_t vpn = prefix << pt->cfg.bits[level] | i;
+        if (level + 1 == pt->cfg.levels) {
+            if (node[i] & PTE_PRESENT) fn(ctx, vpn, &node[i]);
+        } else if (node[i] & PTE_TABLE) {
+            radix_leaves(pt, PTE_NODE(node[i]), level + 1, vpn, fn, ctx);
+        }
+    }
+}
+
+// bytes the allocated nodes would take with real pte_size entries
+static uint64_t radix_memory(const RadixTable *pt) {
+    uint64_t bytes = 0;
+    for (int l = 0; l < pt->cfg.levels; l++) {
+        bytes += pt->nodes[l] * ((uint64_t)1 << pt->cfg.bits[l]) * (uint64_t)pt->cfg.pte_size;
+    }
+    return bytes;
+}
+
+// ---------------- batch translation kernels ----------------
+
+// read-only translation of an array of addresses through an existing
+// radix table: pa[i] is the physical address, or XLATE_FAULT when the page
+// isn't mapped (or the address is outside the VA). A huge leaf ends the
+// walk early and keeps the address bits below its level. Returns the
+// number of faults. The AVX2/AVX-512 versions walk 4/8 addresses at once, one
+// gather per level, and are picked at runtime from CPUID.
+
+#define XLATE_FAULT UINT64_MAX
+
+typedef size_t (*XlateFn)(const RadixTable *pt, const uint64_t *va, uint64_t *pa, size_t n);
+
+// right shift of the vpn bits each level indexes, counted from bit 0 of
+// the address; it is also the offset width of a leaf at that level
+static void level_shifts(const Config *cfg, int *shift, uint64_t *mask) {
+    int s = cfg->page_shift;
+    for (int l = cfg->levels - 1; l >= 0; l--) {
+        shift[l] = s;
+        mask[l] = (1ULL << cfg->bits[l]) - 1;
+        s += cfg->bits[l];
+    }
+}
+
+static size_t xlate_scalar(const RadixTable *pt, const uint64_t *va, uint64_t *pa, size_t n) {
+    const Config *cfg = &pt->cfg;
+    int shift[MAX_LEVELS];
+    uint64_t mask[MAX_LEVELS];
+    level_shifts(cfg, shift, mask);
+    int last = cfg->levels - 1;
+    size_t faults = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        uint64_t v = va[i];
+        const uint64_t *node = pt->root;
+        uint64_t e = 0;
+        int ok = cfg->va_bits >= 64 || !(v >> cfg->va_bits);
+        int l = 0;
+
+        for (; ok; l++) {
+            e = node[(v >> shift[l]) & mask[l]];
+            if (l == last || (e & PTE_HUGE)) {
+                ok = (e & PTE_PRESENT) != 0;
+                break;
+            }
+            ok = (e & PTE_TABLE) != 0;
+            node = PTE_NODE(e);
+        }
+
+        if (ok) {
+            pa[i] = ((e >> PTE_FRAME_SHIFT) << cfg->page_shift) + (v & ((1ULL << shift[l]) - 1));
+        } else {
+            pa[i] = XLATE_FAULT;
+            faults++;
+        }
+    }
+    return faults;
+}
+
+#if defined(__x86_64__)
+
+// gathers use absolute addresses as indices (base NULL, scale 1); lanes
+// that already failed or reached a leaf are masked off so they never load.
+// A lane that hits a leaf keeps that entry and its level's offset mask.
+
+__attribute__((target("avx2")))
+static size_t xlate_avx2(const RadixTable *pt, const uint64_t *va, uint64_t *pa, size_t n) {
+    const Config *cfg = &pt->cfg;
+    int shift[MAX_LEVELS];
+    uint64_t mask[MAX_LEVELS];
+    level_shifts(cfg, shift, mask);
+    int last = cfg->levels - 1;
+    size_t faults = 0, i = 0;
+
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i node_mask = _mm256_set1_epi64x((long long)~0xFULL);
+    const __m256i fault = _mm256_set1_epi64x(-1);
+    const __m256i table_bit = _mm256_set1_epi64x(PTE_TABLE);
+    const __m256i present_bit = _mm256_set1_epi64x(PTE_PRESENT);
+    const __m256i huge_bits = _mm256_set1_epi64x(PTE_HUGE | PTE_PRESENT);
+    const __m128i page_shift = _mm_cvtsi32_si128(cfg->page_shift);
+    const __m128i frame_shift = _mm_cvtsi32_si128(PTE_FRAME_SHIFT);
+    const __m128i va_shift = _mm_cvtsi32_si128(cfg->va_bits < 64 ? cfg->va_bits : 0);
+
+    for (; i + 4 <= n; i += 4) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(va + i));
+        __m256i node = _mm256_set1_epi64x((long long)(uintptr_t)pt->root);
+        __m256i walk = fault, ok = zero, leaf = zero, off_mask = zero;
+
+        if (cfg->va_bits < 64) walk = _mm256_cmpeq_epi64(_mm256_srl_epi64(v, va_shift), zero);
+
+        for (int l = 0; l <= last; l++) {
+            __m256i idx = _mm256_and_si256(_mm256_srl_epi64(v, _mm_cvtsi32_si128(shift[l])),
+                                           _mm256_set1_epi64x((long long)mask[l]));
+            __m256i addr = _mm256_add_epi64(node, _mm256_slli_epi64(idx, 3));
+            __m256i e = _mm256_mask_i64gather_epi64(zero, (const long long *)0, addr, walk, 1);
+            __m256i bit = (l == last) ? present_bit : huge_bits;
+            __m256i hit = _mm256_and_si256(walk, _mm256_cmpeq_epi64(_mm256_and_si256(e, bit), bit));
+            ok = _mm256_or_si256(ok, hit);
+            leaf = _mm256_blendv_epi8(leaf, e, hit);
+            off_mask = _mm256_blendv_epi8(off_mask, _mm256_set1_epi64x((long long)((1ULL << shift[l]) - 1)), hit);
+            walk = _mm256_and_si256(walk, _mm256_cmpeq_epi64(_mm256_and_si256(e, table_bit), table_bit));
+            node = _mm256_and_si256(e, node_mask);
+        }
+
+        __m256i frame = _mm256_srl_epi64(leaf, frame_shift);
+        __m256i phys = _mm256_add_epi64(_mm256_sll_epi64(frame, page_shift), _mm256_and_si256(v, off_mask));
+        phys = _mm256_blendv_epi8(fault, phys, ok);
+        _mm256_storeu_si256((__m256i *)(pa + i), phys);
+        faults += (size_t)__builtin_popcount(~_mm256_movemask_pd(_mm256_castsi256_pd(ok)) & 0xF);
+    }
+
+    return faults + xlate_scalar(pt, va + i, pa + i, n - i);
+}
+
+__attribute__((target("avx512f")))
+static size_t xlate_avx512(const RadixTable *pt, const uint64_t *va, uint64_t *pa, size_t n) {
+    const Config *cfg = &pt->cfg;
+    int shift[MAX_LEVELS];
+    uint64_t mask[MAX_LEVELS];
+    level_shifts(cfg, shift, mask);
+    int last = cfg->levels - 1;
+    size_t faults = 0, i = 0;
+
+    const __m512i zero = _mm512_setzero_si512();
+    const __m512i node_mask = _mm512_set1_epi64((long long)~0xFULL);
+    const __m512i fault = _mm512_set1_epi64(-1);
+    const __m512i table_bit = _mm512_set1_epi64(PTE_TABLE);
+    const __m512i present_bit = _mm512_set1_epi64(PTE_PRESENT);
+    const __m512i huge_bits = _mm512_set1_epi64(PTE_HUGE | PTE_PRESENT);
+
+    for (; i + 8 <= n; i += 8) {
+        __m512i v = _mm512_loadu_si512((const void *)(va + i));
+        __m512i node = _mm512_set1_epi64((long long)(uintptr_t)pt->root);
+        __mmask8 walk = 0xFF, ok = 0;
+        __m512i leaf = zero, off_mask = zero;
+
+        if (cfg->va_bits < 64) walk = _mm512_cmpeq_epi64_mask(_mm512_srli_epi64(v, (unsigned)cfg->va_bits), zero);
+
+        for (int l = 0; l <= last; l++) {
+            __m512i idx = _mm512_and_si512(_mm512_srli_epi64(v, (unsigned)shift[l]),
+                                           _mm512_set1_epi64((long long)mask[l]));
+            __m512i addr = _mm512_add_epi64(node, _mm512_slli_epi64(idx, 3));
+            __m512i e = _mm512_mask_i64gather_epi64(zero, walk, addr, (const void *)0, 1);
+            __m512i bit = (l == last) ? present_bit : huge_bits;
+            __mmask8 hit = walk & _mm512_cmpeq_epi64_mask(_mm512_and_si512(e, bit), bit);
+            ok |= hit;
+            leaf = _mm512_mask_blend_epi64(hit, leaf, e);
+            off_mask = _mm512_mask_blend_epi64(hit, off_mask, _mm512_set1_epi64((long long)((1ULL << shift[l]) - 1)));
+            walk &= _mm512_test_epi64_mask(e, table_bit);
+            node = _mm512_and_si512(e, node_mask);
+        }
+
+        __m512i frame = _mm512_srli_epi64(leaf, PTE_FRAME_SHIFT);
+        __m512i phys = _mm512_add_epi64(_mm512_slli_epi64(frame, (unsigned)cfg->page_shift),
+                                        _mm512_and_si512(v, off_mask));
+        _mm512_storeu_si512((void *)(pa + i), _mm512_mask_blend_epi64(ok, fault, phys));
+        faults += (size_t)__builtin_popcount((unsigned)(~ok & 0xFF));
+    }
+
+    return faults + xlate_scalar(pt, va + i, pa + i, n - i);
+}
+
+#endif
+
+static const struct {
+    const char *name;
+    XlateFn fn;
+} g_kernels[] = {
+    {"scalar", xlate_scalar},
+#if defined(__x86_64__)
+    {"avx2", xlate_avx2},
+    {"avx512", xlate_avx512},
+#endif
+};
+#define NUM_KERNELS ((int)(sizeof(g_kernels) / sizeof(g_kernels[0])))
+
+static int kernel_supported(int k) {
+#if defined(__x86_64__)
+    if (strcmp(g_kernels[k].name, "avx2") == 0) return __builtin_cpu_supports("avx2");
+    if (strcmp(g_kernels[k].name, "avx512") == 0) return __builtin_cpu_supports("avx512f");
+#endif
+    return 1;
+}
+
+// widest kernel this CPU runs, or the one named (-1 if unknown/unsupported)
+static int pick_kernel(const char *name) {
+    __builtin_cpu_init();
+    for (int k = NUM_KERNELS - 1; k >= 0; k--) {
+        if (name ? strcmp(g_kernels[k].name, name) == 0 : kernel_supported(k)) {
+            return kernel_supported(k) ? k : -1;
+        }
+    }
+    return -1;
+}
+
+// ---------------- TLB ----------------
+
+typedef struct {
+    uint64_t vpn;       // vpn >> order
+    uint64_t frame;     // first frame of the page
+    uint64_t stamp;     // last use (LRU) or fill time (FIFO)
+    uint32_t asid;
+    int order;          // log2 of the base pages the entry covers
+    int valid;
+} TlbEntry;
+
+typedef struct {
+    TlbSpec spec;
+    int sets;
+    TlbEntry *e;        // sets * ways, one set after another
+    uint64_t clock;
+    uint64_t rng;
+    uint64_t lookups, hits, flushes;
+    uint64_t orders;    // page orders filled so far, one bit each
+} Tlb;
+
+static void tlb_init(Tlb *t, const TlbSpec *spec) {
+    memset(t, 0, sizeof(*t));
+    t->spec = *spec;
+    t->sets = spec->entries / spec->ways;
+    t->rng = 0x9E3779B97F4A7C15ULL;
+    t->e = calloc((size_t)spec->entries, sizeof(TlbEntry));
+    if (!t->e) {
+        perror("calloc");
+        exit(1);
+    }
+}
+
+static void tlb_destroy(Tlb *t) {
+    free(t->e);
+    t->e = NULL;
+}
+
+static inline TlbEntry *tlb_set(Tlb *t, uint64_t vpn) {
+    return &t->e[(size_t)(vpn % (uint64_t)t->sets) * (size_t)t->spec.ways];
+}
+
+// one probe per page size in use, counted as a single lookup
+static int tlb_lookup(Tlb *t, uint32_t asid, uint64_t vpn, uint64_t *frame, int *order) {
+    t->lookups++;
+    t->clock++;
+
+    uint64_t orders = t->orders | 1;
+    for (int o = 0; orders; o++, orders >>= 1) {
+        if (!(orders & 1)) continue;
+        uint64_t key = vpn >> o;
+        TlbEntry *set = tlb_set(t, key);
+        for (int w = 0; w < t->spec.ways; w++) {
+            TlbEntry *e = &set[w];
+            if (e->valid && e->vpn == key && e->asid == asid && e->order == o) {
+                if (t->spec.policy == REPL_LRU) e->stamp = t->clock;
+                *frame = e->frame + (vpn & ((1ULL << o) - 1));
+                *order = o;
+                t->hits++;
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+static void tlb_fill(Tlb *t, uint32_t asid, uint64_t vpn, uint64_t frame, int order) {
+    uint64_t key = vpn >> order;
+    TlbEntry *set = tlb_set(t, key);
+    TlbEntry *victim = NULL;
+
+    for (int w = 0; w < t->spec.ways && !victim; w++) {
+        if (!set[w].valid) victim = &set[w];
+    }
+
+    if (!victim) {
+        if (t->spec.policy == REPL_RANDOM) {
+            // xorshift64
+            t->rng ^= t->rng << 13;
+            t->rng ^= t->rng >> 7;
+            t->rng ^= t->rng << 17;
+            victim = &set[t->rng % (uint64_t)t->spec.ways];
+        } else {
+            // LRU and FIFO both evict the oldest stamp
+            victim = &set[0];
+            for (int w = 1; w < t->spec.ways; w++) {
+                if (set[w].stamp < victim->stamp) victim = &set[w];
+            }
+        }
+    }
+
+    victim->valid = 1;
+    victim->asid = asid;
+    victim->vpn = key;
+    victim->frame = frame & ~((1ULL << order) - 1);
+    victim->order = order;
+    victim->stamp = ++t->clock;
+    t->orders |= 1ULL << order;
+}
+
+static void tlb_invalidate(Tlb *t, uint32_t asid, uint64_t vpn) {
+    TlbEntry *set = tlb_set(t, vpn);
+    for (int w = 0; w < t->spec.ways; w++) {
+        if (set[w].valid && set[w].vpn == vpn && set[w].asid == asid && set[w].order == 0) set[w].valid = 0;
+    }
+}
+
+// every entry overlapping vpns [lo, lo + n), whatever its size
+static void tlb_invalidate_range(Tlb *t, uint32_t asid, uint64_t lo, uint64_t n) {
+    for (int i = 0; i < t->spec.entries; i++) {
+        TlbEntry *e = &t->e[i];
+        uint64_t start = e->vpn << e->order;
+        if (e->valid && e->asid == asid && start < lo + n && lo < start + (1ULL << e->order)) e->valid = 0;
+    }
+}
+
+static void tlb_flush(Tlb *t) {
+    for (int i = 0; i < t->spec.entries; i++) t->e[i].valid = 0;
+    t->flushes++;
+}
+
+// every entry of one address space
+static void tlb_flush_asid(Tlb *t, uint32_t asid) {
+    for (int i = 0; i < t->spec.entries; i++) {
+        if (t->e[i].asid == asid) t->e[i].valid = 0;
+    }
+    t->flushes++;
+}
+
+// ---------------- data caches ----------------
+
+// set-associative, write-back, write-allocate, LRU caches fed the
+// physical address of every translated reference. Levels are
+//   non-inclusive  a miss fills every level above the hit; victims
+//                  leave quietly unless dirty
+//   inclusive      the same, and a line leaving a lower level is
+//                  invalidated above it (back-invalidation)
+//   exclusive      a line lives in one level: hits below L1 move it up,
+//                  fills go to L1 only and victims drop one level
+// Dirty victims are written into the next level (or memory).
+
+typedef struct {
+    uint64_t line;      // physical address >> line shift
+    uint64_t stamp;     // LRU
+    int valid, dirty;
+} CacheLine;
+
+typedef struct {
+    CacheSpec spec;
+    uint64_t sets;
+    CacheLine *l;       // sets * ways
+    uint64_t clock;
+    uint64_t accesses, hits, writebacks, back_invals;
+} Cache;
+
+typedef struct {
+    Cache c[MAX_CACHES];
+    int n, mode;
+    int line_shift;
+    uint64_t mem_reads, mem_writes;     // lines moved to and from memory
+} CacheHier;
+
+static void caches_init(CacheHier *h, const Config *cfg) {
+    memset(h, 0, sizeof(*h));
+    h->n = cfg->ncache;
+    h->mode = cfg->cache_mode;
+    h->line_shift = h->n ? log2_exact((uint64_t)cfg->cache[0].line) : 0;
+    for (int i = 0; i < h->n; i++) {
+        Cache *c = &h->c[i];
+        c->spec = cfg->cache[i];
+        c->sets = c->spec.size / ((uint64_t)c->spec.ways * (uint64_t)c->spec.line);
+        c->l = calloc(c->spec.size / (uint64_t)c->spec.line, sizeof(CacheLine));
+        if (!c->l) {
+            perror("calloc");
+            exit(1);
+        }
+    }
+}
+
+static void caches_destroy(CacheHier *h) {
+    for (int i = 0; i < h->n; i++) free(h->c[i].l);
+}
+
+static inline CacheLine *cache_set(Cache *c, uint64_t line) {
+    return &c->l[(line % c->sets) * (uint64_t)c->spec.ways];
+}
+
+static CacheLine *cache_find(Cache *c, uint64_t line) {
+    CacheLine *set = cache_set(c, line);
+    for (int w = 0; w < c->spec.ways; w++) {
+        if (set[w].valid && set[w].line == line) return &set[w];
+    }
+    return NULL;
+}
+
+// drop line if present; returns its dirty bit, -1 if it wasn't there
+static int cache_remove(Cache *c, uint64_t line) {
+    CacheLine *e = cache_find(c, line);
+    if (!e) return -1;
+    e->valid = 0;
+    return e->dirty;
+}
+
+// put a line that is not present into level i, pushing out the LRU way
+static void cache_fill(CacheHier *h, int i, uint64_t line, int dirty) {
+    Cache *c = &h->c[i];
+    CacheLine *set = cache_set(c, line), *v = &set[0];
+    for (int w = 0; w < c->spec.ways; w++) {
+        if (!set[w].valid) {
+            v = &set[w];
+            break;
+        }
+        if (set[w].stamp < v->stamp) v = &set[w];
+    }
+
+    CacheLine old = *v;
+    v->line = line;
+    v->valid = 1;
+    v->dirty = dirty;
+    v->stamp = ++c->clock;
+    if (!old.valid) return;
+
+    if (h->mode == CACHE_INCLUSIVE) {
+        for (int j = 0; j < i; j++) {
+            int d = cache_remove(&h->c[j], old.line);
+            if (d >= 0) c->back_invals++;
+            if (d > 0) old.dirty = 1;
+        }
+    }
+
+    if (h->mode == CACHE_EXCLUSIVE) {
+        // victims drop a level, clean or not
+        if (i + 1 < h->n) cache_fill(h, i + 1, old.line, old.dirty);
+        else if (old.dirty) h->mem_writes++;
+        if (old.dirty) c->writebacks++;
+        return;
+    }
+    if (!old.dirty) return;
+
+    c->writebacks++;
+    if (i + 1 == h->n) {
+        h->mem_writes++;
+        return;
+    }
+    CacheLine *below = cache_find(&h->c[i + 1], old.line);
+    if (below) below->dirty = 1;
+    else cache_fill(h, i + 1, old.line, 1);
+}
+
+static void cache_access(CacheHier *h, uint64_t paddr, int write) {
+    uint64_t line = paddr >> h->line_shift;
+    int hit = h->n;
+
+    for (int i = 0; i < h->n; i++) {
+        Cache *c = &h->c[i];
+        c->accesses++;
+        CacheLine *e = cache_find(c, line);
+        if (e) {
+            c->hits++;
+            e->stamp = ++c->clock;
+            if (i == 0 && write) e->dirty = 1;
+            hit = i;
+            break;
+        }
+    }
+    if (hit == 0) return;
+    if (hit == h->n) h->mem_reads++;
+
+    if (h->mode == CACHE_EXCLUSIVE) {
+        int dirty = write;
+        if (hit < h->n && cache_remove(&h->c[hit], line) > 0) dirty = 1;
+        cache_fill(h, 0, line, dirty);
+        return;
+    }
+    // fill from the bottom up, so an inclusive level never evicts the
+    // line being brought in above it
+    for (int i = hit - 1; i >= 0; i--) cache_fill(h, i, line, i == 0 && write);
+}
+
+static void caches_merge(CacheHier *dst, const CacheHier *src) {
+    for (int i = 0; i < dst->n; i++) {
+        dst->c[i].accesses += src->c[i].accesses;
+        dst->c[i].hits += src->c[i].hits;
+        dst->c[i].writebacks += src->c[i].writebacks;
+        dst->c[i].back_invals += src->c[i].back_invals;
+    }
+    dst->mem_reads += src->mem_reads;
+    dst->mem_writes += src->mem_writes;
+}
+
+// ---------------- page map ----------------
+
+// open-addressing map from (pid, vpn) to a 64-bit value, insert only
+typedef struct {
+    uint64_t vpn;
+    uint64_t val;
+    uint32_t pid;
+    uint32_t used;
+} PageMapSlot;
+
+typedef struct {
+    PageMapSlot *slot;
+    size_t cap;         // power of two
+    size_t count;
+} PageMap;
+
+static inline size_t page_hash(uint32_t pid, uint64_t vpn) {
+    uint64_t h = vpn * 0x9E3779B97F4A7C15ULL ^ (uint64_t)pid * 0xC2B2AE3D27D4EB4FULL;
+    return (size_t)(h ^ (h >> 29));
+}
+
+static void pagemap_init(PageMap *m, size_t expect) {
+    m->cap = 1024;
+    while (m->cap < expect * 2) m->cap <<= 1;
+    m->count = 0;
+    m->slot = calloc(m->cap, sizeof(PageMapSlot));
+    if (!m->slot) {
+        perror("calloc");
+        exit(1);
+    }
+}
+
+static void pagemap_destroy(PageMap *m) {
+    free(m->slot);
+    m->slot = NULL;
+}
+
+// value slot for (pid, vpn); with create, a missing key is added with
+// *created set and the value zeroed
+static uint64_t *pagemap_get(PageMap *m, uint32_t pid, uint64_t vpn, int *created) {
+    if (created && (m->count + 1) * 4 > m->cap * 3) {
+        PageMap big;
+        pagemap_init(&big, m->cap);
+        for (size_t i = 0; i < m->cap; i++) {
+            if (!m->slot[i].used) continue;
+            size_t j = page_hash(m->slot[i].pid, m->slot[i].vpn) & (big.cap - 1);
+            while (big.slot[j].used) j = (j + 1) & (big.cap - 1);
+            big.slot[j] = m->slot[i];
+        }
+        big.count = m->count;
+        free(m->slot);
+        *m = big;
+    }
+
+    size_t mask = m->cap - 1;
+    size_t i = page_hash(pid, vpn) & mask;
+    while (m->slot[i].used) {
+        if (m->slot[i].vpn == vpn && m->slot[i].pid == pid) {
+            if (created) *created = 0;
+            return &m->slot[i].val;
+        }
+        i = (i + 1) & mask;
+    }
+    if (!created) return NULL;
+
+    m->slot[i].used = 1;
+    m->slot[i].pid = pid;
+    m->slot[i].vpn = vpn;
+    m->slot[i].val = 0;
+    m->count++;
+    *created = 1;
+    return &m->slot[i].val;
+}
+
+// ---------------- hashed page table ----------------
+
+// per-process hash of vpn -> PTE with chaining; buckets double once the
+// load factor passes 1 so chains stay short
+typedef struct HashNode {
+    uint64_t vpn;
+    uint64_t pte;
+    struct HashNode *next;
+    uint64_t slab;      // --slab handle
+} HashNode;
+
+typedef struct {
+    HashNode **bucket;
+    size_t nbuckets;    // power of two
+    size_t count;
+    PhysMem *mem;       // --slab: chain nodes also take slab objects
+} HashTable;
+
+// a chain node as the table would lay it out: tag, PTE, next pointer
+#define HASH_NODE_BYTES 24
+
+static void hash_init(HashTable *h, PhysMem *mem) {
+    h->mem = mem;
+    h->nbuckets = 1024;
+    h->count = 0;
+    h->bucket = calloc(h->nbuckets, sizeof(HashNode *));
+    if (!h->bucket) {
+        perror("calloc");
+        exit(1);
+    }
+}
+
+static void hash_destroy(HashTable *h) {
+    for (size_t b = 0; b < h->nbuckets; b++) {
+        HashNode *n = h->bucket[b];
+        while (n) {
+            HashNode *next = n->next;
+            if (h->mem) slab_free(h->mem, n->slab);
+            free(n);
+            n = next;
+        }
+    }
+    free(h->bucket);
+    h->bucket = NULL;
+}
+
+// node for vpn or NULL; *refs = bucket read plus nodes visited
+static HashNode *hash_find(const HashTable *h, uint64_t vpn, int *refs) {
+    HashNode *n = h->bucket[page_hash(0, vpn) & (h->nbuckets - 1)];
+    int r = 1;
+    for (; n; n = n->next) {
+        r++;
+        if (n->vpn == vpn) break;
+    }
+    if (refs) *refs = r;
+    return n;
+}
+
+static void hash_insert(HashTable *h, uint64_t vpn, uint64_t pte) {
+    if (h->count + 1 > h->nbuckets) {
+        size_t nb = h->nbuckets * 2;
+        HashNode **big = calloc(nb, sizeof(HashNode *));
+        if (!big) {
+            perror("calloc");
+            exit(1);
+        }
+        for (size_t b = 0; b < h->nbuckets; b++) {
+            HashNode *n = h->bucket[b];
+            while (n) {
+                HashNode *next = n->next;
+                size_t j = page_hash(0, n->vpn) & (nb - 1);
+                n->next = big[j];
+                big[j] = n;
+                n = next;
+            }
+        }
+        free(h->bucket);
+        h->bucket = big;
+        h->nbuckets = nb;
+    }
+
+    HashNode *n = malloc(sizeof(HashNode));
+    if (!n) {
+        perror("malloc");
+        exit(1);
+    }
+    size_t b = page_hash(0, vpn) & (h->nbuckets - 1);
+    if (h->mem) n->slab = slab_alloc(h->mem, HASH_NODE_BYTES);
+    n->vpn = vpn;
+    n->pte = pte;
+    n->next = h->bucket[b];
+    h->bucket[b] = n;
+    h->count++;
+}
+
+static void hash_remove(HashTable *h, uint64_t vpn) {
+    HashNode **pp = &h->bucket[page_hash(0, vpn) & (h->nbuckets - 1)];
+    for (; *pp; pp = &(*pp)->next) {
+        if ((*pp)->vpn == vpn) {
+            HashNode *n = *pp;
+            *pp = n->next;
+            if (h->mem) slab_free(h->mem, n->slab);
+            free(n);
+            h->count--;
+            return;
+        }
+    }
+}
+
+static void hash_leaves(const HashTable *h, LeafFn fn, void *ctx) {
+    for (size_t b = 0; b < h->nbuckets; b++) {
+        for (HashNode *n = h->bucket[b]; n; n = n->next) fn(ctx, n->vpn, &n->pte);
+    }
+}
+
+static uint64_t hash_memory(const HashTable *h) {
+    return h->nbuckets * sizeof(HashNode *) + h->count * HASH_NODE_BYTES;
+}
+
+// ---------------- inverted page table ----------------
+
+// one entry per physical frame, shared by every process. Finding the
+// frame for (pid, vpn) goes through a cuckoo hash: two tables, two hash
+// functions, so a lookup probes at most two slots.
+
+#define CUCKOO_MAX_KICKS 64
+
+typedef struct {
+    uint64_t vpn;
+    uint32_t pid;
+    uint32_t valid;
+} IptEntry;
+
+typedef struct {
+    uint64_t vpn;
+    uint64_t frame;
+    uint32_t pid;
+    uint32_t used;
+} CuckooSlot;
+
+typedef struct {
+    IptEntry *ipt;
+    uint64_t nipt;          // entries allocated
+    CuckooSlot *slot[2];
+    size_t cap;             // slots per table, power of two
+    size_t count;
+    uint64_t kicks, rehashes;
+} InvTable;
+
+static inline size_t page_hash2(uint32_t pid, uint64_t vpn) {
+    uint64_t h = (vpn ^ (uint64_t)pid << 40) * 0xFF51AFD7ED558CCDULL;
+    return (size_t)(h ^ (h >> 33));
+}
+
+static inline size_t cuckoo_pos(const InvTable *t, int which, uint32_t pid, uint64_t vpn) {
+    return (which ? page_hash2(pid, vpn) : page_hash(pid, vpn)) & (t->cap - 1);
+}
+
+static void cuckoo_alloc(InvTable *t, size_t cap) {
+    t->cap = cap;
+    for (int w = 0; w < 2; w++) {
+        t->slot[w] = calloc(cap, sizeof(CuckooSlot));
+        if (!t->slot[w]) {
+            perror("calloc");
+            exit(1);
+        }
+    }
+}
+
+// frames: IPT size up front, 0 to grow with the frames handed out
+static void inv_init(InvTable *t, uint64_t frames) {
+    memset(t, 0, sizeof(*t));
+    t->nipt = frames ? frames : 1024;
+    t->ipt = calloc(t->nipt, sizeof(IptEntry));
+    if (!t->ipt) {
+        perror("calloc");
+        exit(1);
+    }
+    size_t cap = 1024;
+    while (frames && cap < frames) cap <<= 1;
+    cuckoo_alloc(t, cap);
+}
+
+static void inv_destroy(InvTable *t) {
+    free(t->ipt);
+    free(t->slot[0]);
+    free(t->slot[1]);
+}
+
+// frame of (pid, vpn); *refs = cuckoo slots probed plus the IPT entry
+static int inv_find(const InvTable *t, uint32_t pid, uint64_t vpn, uint64_t *frame, int *refs) {
+    for (int w = 0; w < 2; w++) {
+        const CuckooSlot *c = &t->slot[w][cuckoo_pos(t, w, pid, vpn)];
+        if (c->used && c->vpn == vpn && c->pid == pid) {
+            if (refs) *refs = w + 2;
+            *frame = c->frame;
+            return 1;
+        }
+    }
+    if (refs) *refs = 2;
+    return 0;
+}
+
+static void cuckoo_insert(InvTable *t, CuckooSlot in);
+
+// twice the slots, everything reinserted
+static void cuckoo_grow(InvTable *t) {
+    CuckooSlot *old[2] = {t->slot[0], t->slot[1]};
+    size_t ocap = t->cap;
+
+    cuckoo_alloc(t, ocap * 2);
+    t->count = 0;
+    t->rehashes++;
+    for (int w = 0; w < 2; w++) {
+        for (size_t i = 0; i < ocap; i++) {
+            if (old[w][i].used) cuckoo_insert(t, old[w][i]);
+        }
+        free(old[w]);
+    }
+}
+
+static void cuckoo_insert(InvTable *t, CuckooSlot in) {
+    // keep the load at or below one half
+    if (t->count + 1 > t->cap) cuckoo_grow(t);
+
+    in.used = 1;
+    int w = 0;
+    for (int kick = 0; kick < CUCKOO_MAX_KICKS; kick++) {
+        CuckooSlot *c = &t->slot[w][cuckoo_pos(t, w, in.pid, in.vpn)];
+        if (!c->used) {
+            *c = in;
+            t->count++;
+            return;
+        }
+        // take the slot, move its owner to its other table
+        CuckooSlot out = *c;
+        *c = in;
+        in = out;
+        w ^= 1;
+        t->kicks++;
+    }
+
+    // a cycle: grow and try again
+    cuckoo_grow(t);
+    cuckoo_insert(t, in);
+}
+
+static void inv_insert(InvTable *t, uint32_t pid, uint64_t vpn, uint64_t frame) {
+    if (frame >= t->nipt) {
+        uint64_t n = t->nipt;
+        while (frame >= n) n *= 2;
+        IptEntry *ni = realloc(t->ipt, n * sizeof(IptEntry));
+        if (!ni) {
+            perror("realloc");
+            exit(1);
+        }
+        memset(ni + t->nipt, 0, (n - t->nipt) * sizeof(IptEntry));
+        t->ipt = ni;
+        t->nipt = n;
+    }
+    t->ipt[frame].vpn = vpn;
+    t->ipt[frame].pid = pid;
+    t->ipt[frame].valid = 1;
+
+    CuckooSlot c = {vpn, frame, pid, 1};
+    cuckoo_insert(t, c);
+}
+
+static void inv_remove(InvTable *t, uint32_t pid, uint64_t vpn) {
+    for (int w = 0; w < 2; w++) {
+        CuckooSlot *c = &t->slot[w][cuckoo_pos(t, w, pid, vpn)];
+        if (c->used && c->vpn == vpn && c->pid == pid) {
+            t->ipt[c->frame].valid = 0;
+            c->used = 0;
+            t->count--;
+            return;
+        }
+    }
+}
+
+static uint64_t inv_memory(const InvTable *t) {
+    return t->nipt * sizeof(IptEntry) + 2 * t->cap * sizeof(CuckooSlot);
+}
+
+// ---------------- trace ----------------
+
+#define REF_WRITE 0x1
+#define REF_FORK  0x2       // pid forks a child whose pid is in addr
+#define REF_EXIT  0x4       // pid exits
+#define REF_EVENT (REF_FORK | REF_EXIT)
+
+// one memory reference
+typedef struct {
+    uint64_t addr;
+    uint32_t pid;
+    uint32_t flags;
+} Ref;
+
+typedef struct {
+    Ref *refs;
+    size_t n, cap;
+} Trace;
+
+static void trace_push(Trace *t, uint32_t pid, uint64_t addr, uint32_t flags) {
+    if (t->n == t->cap) {
+        t->cap = t->cap ? t->cap * 2 : 4096;
+        Ref *nr = realloc(t->refs, t->cap * sizeof(Ref));
+        if (!nr) {
+            perror("realloc");
+            exit(1);
+        }
+        t->refs = nr;
+    }
+    t->refs[t->n].addr = addr;
+    t->refs[t->n].pid = pid;
+    t->refs[t->n].flags = flags;
+    t->n++;
+}
+
+// parse "[pid:]addr[:r|w]", "fork:parent:child" or "exit:pid"; -1 if
+// it isn't one
+static int parse_access(const char *tok, uint32_t *pid, uint64_t *addr, uint32_t *flags) {
+    char *end;
+    uint64_t field[2];
+    int nfield = 0;
+
+    *pid = 0;
+    *flags = 0;
+
+    if (strncmp(tok, "fork:", 5) == 0 || strncmp(tok, "exit:", 5) == 0) {
+        int nwant = tok[0] == 'f' ? 2 : 1;
+        field[1] = 0;
+        for (tok += 5; nfield < nwant; tok = end + 1) {
+            field[nfield] = strtoull(tok, &end, 0);
+            if (end == tok || field[nfield] > UINT32_MAX) return -1;
+            if (*end != (++nfield < nwant ? ':' : '\0')) return -1;
+        }
+        *pid = (uint32_t)field[0];
+        *addr = field[1];
+        *flags = nwant == 2 ? REF_FORK : REF_EXIT;
+        return 0;
+    }
+
+    for (;;) {
+        if ((tok[0] == 'r' || tok[0] == 'w' || tok[0] == 'R' || tok[0] == 'W') && tok[1] == '\0' && nfield > 0) {
+            if (tok[0] == 'w' || tok[0] == 'W') *flags |= REF_WRITE;
+            break;
+        }
+        if (nfield == 2) return -1;
+        field[nfield++] = strtoull(tok, &end, 0);
+        if (end == tok) return -1;
+        if (*end == '\0') break;
+        if (*end != ':') return -1;
+        tok = end + 1;
+    }
+
+    if (nfield == 2) {
+        if (field[0] > UINT32_MAX) return -1;
+        *pid = (uint32_t)field[0];
+        *addr = field[1];
+    } else {
+        *addr = field[0];
+    }
+    return 0;
+}
+
+// read whitespace separated references; bad tokens are reported and skipped
+static void trace_load_text(FILE *in, Trace *t, const Config *cfg, uint64_t *bad) {
+    char tok[96];
+    while (fscanf(in, "%95s", tok) == 1) {
+        uint32_t pid, flags;
+        uint64_t addr;
+        if (parse_access(tok, &pid, &addr, &flags) != 0) {
+            (*bad)++;
+            if (!cfg->quiet) printf("Logical: %s | INVALID (not an address)\n", tok);
+            continue;
+        }
+        if (cfg->va_bits < 64 && (addr >> cfg->va_bits)) {
+            (*bad)++;
+            if (!cfg->quiet) printf("Logical: %s | INVALID (outside %d-bit address space)\n", tok, cfg->va_bits);
+            continue;
+        }
+        trace_push(t, pid, addr, flags);
+    }
+}
+
+// next_use[i] = index of the next reference to the same page, or
+// UINT64_MAX; one backwards pass. Returns the number of distinct pages.
+static uint64_t trace_next_use(const Trace *t, int page_shift, uint64_t *next_use) {
+    PageMap last;
+    pagemap_init(&last, 1 << 16);
+
+    for (size_t i = t->n; i-- > 0;) {
+        if (t->refs[i].flags & REF_EVENT) {
+            next_use[i] = UINT64_MAX;
+            continue;
+        }
+        int created;
+        uint64_t *v = pagemap_get(&last, t->refs[i].pid, t->refs[i].addr >> page_shift, &created);
+        next_use[i] = created ? UINT64_MAX : *v;
+        *v = i;
+    }
+
+    uint64_t distinct = last.count;
+    pagemap_destroy(&last);
+    return distinct;
+}
+
+// ---------------- trace files ----------------
+
+// --trace FILE is mapped and parsed in batches instead of going through
+// stdio, and results go out through one large buffer
+
+enum { FMT_TEXT, FMT_BIN, FMT_REF };
+
+#define BATCH 4096
+#define OUT_BUF (1 << 20)
+
+typedef struct {
+    const char *p, *end;    // unread part of the mapping
+    int format;
+    uint64_t bad;           // unparsable tokens / bad records
+    int va_bits;
+} TraceReader;
+
+static void *map_file(const char *path, size_t *len) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror(path);
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        perror("fstat");
+        close(fd);
+        return NULL;
+    }
+    *len = (size_t)st.st_size;
+    if (*len == 0) {
+        fprintf(stderr, "%s: empty trace\n", path);
+        close(fd);
+        return NULL;
+    }
+
+    void *m = mmap(NULL, *len, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+    close(fd);
+    if (m == MAP_FAILED) {
+        perror("mmap");
+        return NULL;
+    }
+    madvise(m, *len, MADV_SEQUENTIAL);
+    return m;
+}
+
+static inline int is_space(char c) {
+    return c == ' ' || c == '\n' || c == '\t' || c == '\r';
+}
+
+// strtoull(..., 0) on [p, end) without needing a terminator; NULL if no digits
+static const char *parse_num(const char *p, const char *end, uint64_t *v) {
+    uint64_t x = 0;
+    const char *start;
+
+    if (end - p > 2 && p[0] == '0' && (p[1] == 'x' || p[1] == 'X')) {
+        p += 2;
+        start = p;
+        for (; p < end; p++) {
+            unsigned c = (unsigned char)*p, d;
+            if (c - '0' < 10) d = c - '0';
+            else if ((c | 0x20) - 'a' < 6) d = (c | 0x20) - 'a' + 10;
+            else break;
+            x = x << 4 | d;
+        }
+    } else {
+        unsigned base = (p < end && *p == '0') ? 8 : 10;
+        start = p;
+        for (; p < end && (unsigned)(*p - '0') < base; p++) x = x * base + (unsigned)(*p - '0');
+    }
+
+    if (p == start) return NULL;
+    *v = x;
+    return p;
+}
+
+// same syntax as parse_access: "[pid:]addr[:r|w]" or a process event
+static int parse_text_ref(const char *p, const char *end, Ref *r) {
+    uint64_t field[2];
+    int nfield = 0;
+
+    r->flags = 0;
+
+    if (end - p > 5 && (memcmp(p, "fork:", 5) == 0 || memcmp(p, "exit:", 5) == 0)) {
+        int nwant = p[0] == 'f' ? 2 : 1;
+        field[1] = 0;
+        for (p += 5; nfield < nwant; p++) {
+            p = parse_num(p, end, &field[nfield]);
+            if (!p || field[nfield] > UINT32_MAX) return -1;
+            if (++nfield < nwant ? (p == end || *p != ':') : p != end) return -1;
+        }
+        r->pid = (uint32_t)field[0];
+        r->addr = field[1];
+        r->flags = nwant == 2 ? REF_FORK : REF_EXIT;
+        return 0;
+    }
+    for (;;) {
+        if (nfield > 0 && end - p == 1 && ((*p | 0x20) == 'r' || (*p | 0x20) == 'w')) {
+            if ((*p | 0x20) == 'w') r->flags |= REF_WRITE;
+            break;
+        }
+        if (nfield == 2) return -1;
+        p = parse_num(p, end, &field[nfield++]);
+        if (!p) return -1;
+        if (p == end) break;
+        if (*p != ':') return -1;
+        p++;
+    }
+
+    if (nfield == 2) {
+        if (field[0] > UINT32_MAX) return -1;
+        r->pid = (uint32_t)field[0];
+        r->addr = field[1];
+    } else {
+        r->pid = 0;
+        r->addr = field[0];
+    }
+    return 0;
+}
+
+// fill up to max references; 0 at end of trace
+static size_t reader_next(TraceReader *rd, Ref *out, size_t max) {
+    size_t n = 0;
+
+    if (rd->format == FMT_BIN) {
+        size_t avail = (size_t)(rd->end - rd->p) / sizeof(uint64_t);
+        if (avail < max) max = avail;
+        for (; n < max; n++) {
+            memcpy(&out[n].addr, rd->p, sizeof(uint64_t));
+            out[n].pid = 0;
+            out[n].flags = 0;
+            rd->p += sizeof(uint64_t);
+        }
+    } else if (rd->format == FMT_REF) {
+        size_t avail = (size_t)(rd->end - rd->p) / sizeof(Ref);
+        if (avail < max) max = avail;
+        memcpy(out, rd->p, max * sizeof(Ref));
+        rd->p += max * sizeof(Ref);
+        n = max;
+    } else {
+        const char *p = rd->p, *end = rd->end;
+        while (n < max) {
+            while (p < end && is_space(*p)) p++;
+            if (p == end) break;
+            const char *tok = p;
+            while (p < end && !is_space(*p)) p++;
+            if (parse_text_ref(tok, p, &out[n]) != 0) {
+                rd->bad++;
+                continue;
+            }
+            n++;
+        }
+        rd->p = p;
+    }
+
+    // drop references outside the address space
+    if (rd->va_bits < 64) {
+        size_t k = 0;
+        for (size_t i = 0; i < n; i++) {
+            if (out[i].addr >> rd->va_bits) rd->bad++;
+            else out[k++] = out[i];
+        }
+        n = k;
+    }
+    return n;
+}
+
+// whole file into t (OPT and policy comparisons need the full trace)
+static void trace_load_file(TraceReader *rd, Trace *t) {
+    Ref buf[BATCH];
+    size_t n;
+    while ((n = reader_next(rd, buf, BATCH)) > 0) {
+        for (size_t i = 0; i < n; i++) trace_push(t, buf[i].pid, buf[i].addr, buf[i].flags);
+    }
+}
+
+// output buffer; when full it is written to stdout, or grown if it holds
+// a worker's output that must wait its turn
+typedef struct {
+    char *buf;
+    size_t n, cap;
+    int grow;
+} OutBuf;
+
+static void out_init(OutBuf *o, size_t cap, int grow) {
+    o->buf = malloc(cap);
+    if (!o->buf) {
+        perror("malloc");
+        exit(1);
+    }
+    o->n = 0;
+    o->cap = cap;
+    o->grow = grow;
+}
+
+static void out_free(OutBuf *o) {
+    free(o->buf);
+    o->buf = NULL;
+}
+
+static void out_flush(OutBuf *o) {
+    if (o->n) fwrite(o->buf, 1, o->n, stdout);
+    o->n = 0;
+}
+
+static inline void out_room(OutBuf *o, size_t need) {
+    if (o->n + need <= o->cap) return;
+    if (!o->grow) {
+        out_flush(o);
+        return;
+    }
+    while (o->n + need > o->cap) o->cap *= 2;
+    char *nb = realloc(o->buf, o->cap);
+    if (!nb) {
+        perror("realloc");
+        exit(1);
+    }
+    o->buf = nb;
+}
+
+static inline void out_hex(OutBuf *o, uint64_t v) {
+    char tmp[16];
+    int k = 0;
+    do {
+        tmp[k++] = "0123456789abcdef"[v & 0xF];
+        v >>= 4;
+    } while (v);
+    o->buf[o->n++] = '0';
+    o->buf[o->n++] = 'x';
+    while (k) o->buf[o->n++] = tmp[--k];
+}
+
+static inline void out_dec(OutBuf *o, uint64_t v) {
+    char tmp[20];
+    int k = 0;
+    do {
+        tmp[k++] = (char)('0' + v % 10);
+        v /= 10;
+    } while (v);
+    while (k) o->buf[o->n++] = tmp[--k];
+}
+
+// ---------------- simulator ----------------
+
+// one process: its own page table (the inverted table is shared, in Sim)
+typedef struct {
+    uint32_t pid;
+    RadixTable pt;
+    HashTable ht;
+} AddrSpace;
+
+// a physical frame when memory is limited (--frames)
+typedef struct {
+    uint64_t vpn;
+    uint64_t last_use;      // virtual time (trace index) of the last reference
+    uint64_t next_use;      // OPT: trace index of the next reference
+    int space;              // owning AddrSpace index, -1 while free
+    int ref, dirty;
+    int prev, next;         // LRU list, most recent at the head
+    int heap_pos;           // OPT max-heap position
+} Frame;
+
+typedef struct {
+    Config cfg;
+
+    AddrSpace *spaces;
+    int nspaces, cap_spaces;
+    AddrSpace *cur;             // process of the previous access
+
+    uint64_t next_frame;        // unlimited memory: frames in first-touch order
+    PhysMem mem;                // --buddy: frames from a buddy allocator instead
+    uint64_t user_frames;       // frames holding pages right now
+    Tlb tlb[2];
+
+    // demand paging with a fixed number of frames
+    Frame *frames;
+    int nframes, used_frames;
+    int hand;                   // FIFO / Clock / WSClock position
+    int lru_head, lru_tail;
+    int *heap, heap_n;          // OPT: frames ordered by next use
+    const uint64_t *next_use;   // OPT: per trace index
+    uint64_t now;               // trace index of the current reference
+
+    XlateFn xlate;              // batch kernel for sim_batch
+    InvTable inv;               // --table inverted
+    CacheHier caches;           // --cache levels
+
+    // --huge: leaves mapped and promotions into each level
+    uint64_t leaves[MAX_LEVELS];
+    uint64_t promotions[MAX_LEVELS];
+    uint64_t copied;            // base pages copied by promotions
+    uint64_t huge_failed;       // huge frames the buddy allocator couldn't supply
+
+    // fork / exit events: frames shared copy-on-write between processes
+    uint32_t *sharers;          // per frame: mappings beyond the first
+    uint64_t cap_sharers;
+    uint64_t shared, peak_shared;   // sum of sharers: frames saved
+    uint64_t forks, exits, fork_pages;
+    uint64_t cow_faults, cow_copies, cow_reuses;
+    uint64_t events_ignored;
+
+    uint64_t translations, invalid;
+    uint64_t walks, walk_refs;
+    uint64_t faults, evictions, writebacks;
+    uint64_t switches;
+    uint64_t cycles;
+} Sim;
+
+enum { COW_NONE, COW_COPY, COW_REUSE };
+
+// what happened to one access, for the per-address line
+typedef struct {
+    uint64_t vpn, offset, frame, physical;
+    int tlb_level;      // 1 = L1 hit, 2 = L2 hit, 0 = page walk
+    int order;          // page size: log2 of base pages, 0 = base page
+    int refs;           // page table references made by the walk
+    int fault;          // page was not resident
+    int cow;            // write to a shared page: COW_COPY or COW_REUSE
+    int evicted;        // the fault pushed out victim_pid:victim_vpn
+    uint32_t victim_pid;
+    uint64_t victim_vpn;
+} Access;
+
+static void sim_init(Sim *s, const Config *cfg, const uint64_t *next_use) {
+    memset(s, 0, sizeof(*s));
+    s->cfg = *cfg;
+    s->next_use = next_use;
+    for (int i = 0; i < cfg->ntlb; i++) tlb_init(&s->tlb[i], &cfg->tlb[i]);
+    s->xlate = g_kernels[pick_kernel(cfg->kernel)].fn;
+    if (cfg->table == TABLE_INVERTED) inv_init(&s->inv, cfg->frames);
+    caches_init(&s->caches, cfg);
+    s->mem.page_shift = cfg->page_shift;
+    if (cfg->buddy_frames) buddy_init(&s->mem.buddy, cfg->buddy_frames);
+
+    if (cfg->frames) {
+        s->nframes = (int)cfg->frames;
+        s->frames = calloc((size_t)s->nframes, sizeof(Frame));
+        s->heap = calloc((size_t)s->nframes, sizeof(int));
+        if (!s->frames || !s->heap) {
+            perror("calloc");
+            exit(1);
+        }
+        for (int f = 0; f < s->nframes; f++) {
+            s->frames[f].space = -1;
+            s->frames[f].prev = s->frames[f].next = -1;
+        }
+        s->lru_head = s->lru_tail = -1;
+    }
+}
+
+static void sim_destroy(Sim *s) {
+    for (int i = 0; i < s->nspaces; i++) {
+        if (s->cfg.table == TABLE_RADIX) radix_destroy(&s->spaces[i].pt);
+        else if (s->cfg.table == TABLE_HASHED) hash_destroy(&s->spaces[i].ht);
+    }
+    free(s->spaces);
+    if (s->cfg.table == TABLE_INVERTED) inv_destroy(&s->inv);
+    for (int i = 0; i < s->cfg.ntlb; i++) tlb_destroy(&s->tlb[i]);
+    free(s->frames);
+    free(s->heap);
+    free(s->sharers);
+    caches_destroy(&s->caches);
+    if (s->mem.buddy.nframes) buddy_destroy(&s->mem.buddy);
+    for (int i = 0; i < s->mem.ncaches; i++) free(s->mem.cache[i].slabs);
+}
+
+static AddrSpace *sim_space(Sim *s, uint32_t pid) {
+    if (s->cur && s->cur->pid == pid) return s->cur;
+
+    for (int i = 0; i < s->nspaces; i++) {
+        if (s->spaces[i].pid == pid) return &s->spaces[i];
+    }
+
+    if (s->nspaces == s->cap_spaces) {
+        int ncap = s->cap_spaces ? s->cap_spaces * 2 : 8;
+        AddrSpace *ns = realloc(s->spaces, (size_t)ncap * sizeof(AddrSpace));
+        if (!ns) {
+            perror("realloc");
+            exit(1);
+        }
+        // cur points into the old array
+        if (s->cur) s->cur = ns + (s->cur - s->spaces);
+        s->spaces = ns;
+        s->cap_spaces = ncap;
+    }
+
+    AddrSpace *sp = &s->spaces[s->nspaces++];
+    memset(sp, 0, sizeof(*sp));
+    sp->pid = pid;
+    PhysMem *mem = s->cfg.slab ? &s->mem : NULL;
+    if (s->cfg.table == TABLE_RADIX) radix_init(&sp->pt, &s->cfg, mem);
+    else if (s->cfg.table == TABLE_HASHED) hash_init(&sp->ht, mem);
+    return sp;
+}
+
+// ---------------- huge pages ----------------
+
+// with --huge, leaves may sit above the last level (2 MiB and 1 GiB on
+// x86-64). Eager promotion maps the biggest allowed page whose region is
+// still empty; a threshold collapses a node into one leaf a level up once
+// that share of it is mapped, the way khugepaged does.
+
+// aligned run of 2^order frames for pages; NO_FRAME if the buddy
+// allocator has no block that big
+static uint64_t frame_alloc(Sim *s, int order) {
+    uint64_t f;
+    if (s->mem.buddy.nframes) {
+        f = buddy_alloc(&s->mem.buddy, order);
+        if (f == NO_FRAME) return f;
+    } else {
+        uint64_t span = 1ULL << order;
+        f = (s->next_frame + span - 1) & ~(span - 1);
+        s->next_frame = f + span;
+    }
+    s->user_frames += 1ULL << order;
+    return f;
+}
+
+// one frame; running out of memory ends the run
+static uint64_t frame_new(Sim *s) {
+    if (!s->mem.buddy.nframes) return frame_alloc(s, 0);
+    s->user_frames++;
+    return mem_alloc(&s->mem, 0, "a page");
+}
+
+static void frame_free(Sim *s, uint64_t f, int order) {
+    s->user_frames -= 1ULL << order;
+    if (s->mem.buddy.nframes) buddy_free(&s->mem.buddy, f, order);
+}
+
+static void huge_promote(Sim *s, AddrSpace *sp, uint64_t vpn, int level) {
+    const Config *cfg = &s->cfg;
+
+    while (level > 0 && (cfg->huge_levels >> (level - 1) & 1)) {
+        int lv;
+        uint64_t *pe = radix_walk_to(&sp->pt, vpn, level - 1, 0, NULL, &lv);
+        if (lv != level - 1 || !(*pe & PTE_TABLE)) return;
+
+        // only nodes of leaves collapse, so promotion goes bottom up
+        uint64_t *node = PTE_NODE(*pe);
+        size_t n = (size_t)1 << cfg->bits[level], leaves = 0;
+        for (size_t i = 0; i < n; i++) {
+            if (node[i] & PTE_TABLE) return;
+            if (node[i] & PTE_PRESENT) leaves++;
+        }
+        if (leaves * 100 < (size_t)cfg->promote_pct * n) return;
+
+        int order = level_order(cfg, level - 1);
+        uint64_t huge = frame_alloc(s, order);
+        if (huge == NO_FRAME) {
+            s->huge_failed++;
+            return;
+        }
+        // the small pages are copied into it and their frames given back
+        for (size_t i = 0; i < n; i++) {
+            if (node[i] & PTE_PRESENT) frame_free(s, node[i] >> PTE_FRAME_SHIFT, 0);
+        }
+        node_release(&sp->pt, node, level);
+        sp->pt.nodes[level]--;
+        *pe = (huge << PTE_FRAME_SHIFT) | PTE_HUGE | PTE_PRESENT;
+        sp->pt.mapped -= leaves - 1;
+        s->leaves[level] -= leaves;
+        s->leaves[level - 1]++;
+        s->promotions[level - 1]++;
+        s->copied += (uint64_t)leaves << level_order(cfg, level);
+
+        // the small translations of the region are stale now
+        if (cfg->asid || sp == s->cur) {
+            uint64_t lo = vpn & ~((1ULL << order) - 1);
+            for (int i = 0; i < cfg->ntlb; i++) {
+                tlb_invalidate_range(&s->tlb[i], cfg->asid ? sp->pid : 0, lo, 1ULL << order);
+            }
+        }
+        level--;
+    }
+}
+
+// page walk with mixed page sizes; maps on a fault
+static void huge_access(Sim *s, AddrSpace *sp, Access *a) {
+    const Config *cfg = &s->cfg;
+    int last = cfg->levels - 1, level;
+    uint64_t *e = radix_walk_to(&sp->pt, a->vpn, last, 0, &a->refs, &level);
+
+    if (!(*e & PTE_PRESENT)) {
+        // the region under the empty entry is unmapped, so any page size
+        // from this level down fits
+        int l = last;
+        if (!cfg->promote_pct) {
+            for (int k = level; k < last; k++) {
+                if (cfg->huge_levels >> k & 1) {
+                    l = k;
+                    break;
+                }
+            }
+        }
+
+        // a fragmented buddy allocator may not have a block that big;
+        // fall back to the next smaller size
+        uint64_t f = l < last ? frame_alloc(s, level_order(cfg, l)) : frame_new(s);
+        while (f == NO_FRAME) {
+            s->huge_failed++;
+            do l++; while (l < last && !(cfg->huge_levels >> l & 1));
+            f = l < last ? frame_alloc(s, level_order(cfg, l)) : frame_new(s);
+        }
+
+        e = radix_walk_to(&sp->pt, a->vpn, l, 1, NULL, &level);
+        *e = (f << PTE_FRAME_SHIFT) | PTE_PRESENT | (l < last ? PTE_HUGE : 0);
+        sp->pt.mapped++;
+        s->leaves[l]++;
+        s->faults++;
+        a->fault = 1;
+
+        if (cfg->promote_pct && l == last) {
+            huge_promote(s, sp, a->vpn, last);
+            e = radix_walk_to(&sp->pt, a->vpn, last, 0, NULL, &level);
+        }
+    }
+
+    a->order = level_order(cfg, level);
+    a->frame = (*e >> PTE_FRAME_SHIFT) + (a->vpn & ((1ULL << a->order) - 1));
+}
+
+// the configured page table: look up, map and unmap one page
+
+static int table_lookup(Sim *s, AddrSpace *sp, uint64_t vpn, uint64_t *frame, int *refs) {
+    switch (s->cfg.table) {
+    case TABLE_HASHED: {
+        HashNode *n = hash_find(&sp->ht, vpn, refs);
+        if (!n) return 0;
+        *frame = n->pte >> PTE_FRAME_SHIFT;
+        return 1;
+    }
+    case TABLE_INVERTED:
+        return inv_find(&s->inv, sp->pid, vpn, frame, refs);
+    default: {
+        // missing interior nodes are created on the way down
+        uint64_t *pte = radix_walk(&sp->pt, vpn, 1, refs);
+        if (!(*pte & PTE_PRESENT)) return 0;
+        *frame = *pte >> PTE_FRAME_SHIFT;
+        return 1;
+    }
+    }
+}
+
+static void table_map(Sim *s, AddrSpace *sp, uint64_t vpn, uint64_t frame) {
+    uint64_t pte = (frame << PTE_FRAME_SHIFT) | PTE_PRESENT;
+    switch (s->cfg.table) {
+    case TABLE_HASHED:
+        hash_insert(&sp->ht, vpn, pte);
+        break;
+    case TABLE_INVERTED:
+        inv_insert(&s->inv, sp->pid, vpn, frame);
+        break;
+    default:
+        *radix_walk(&sp->pt, vpn, 1, NULL) = pte;
+        sp->pt.mapped++;
+    }
+}
+
+static void table_unmap(Sim *s, AddrSpace *sp, uint64_t vpn) {
+    switch (s->cfg.table) {
+    case TABLE_HASHED:
+        hash_remove(&sp->ht, vpn);
+        break;
+    case TABLE_INVERTED:
+        inv_remove(&s->inv, sp->pid, vpn);
+        break;
+    default: {
+        uint64_t *pte = radix_walk(&sp->pt, vpn, 0, NULL);
+        if (pte) *pte = 0;
+        sp->pt.mapped--;
+    }
+    }
+}
+
+// LRU list
+
+static void lru_unlink(Sim *s, int f) {
+    Frame *fr = &s->frames[f];
+    if (fr->prev >= 0) s->frames[fr->prev].next = fr->next;
+    else if (s->lru_head == f) s->lru_head = fr->next;
+    if (fr->next >= 0) s->frames[fr->next].prev = fr->prev;
+    else if (s->lru_tail == f) s->lru_tail = fr->prev;
+    fr->prev = fr->next = -1;
+}
+
+static void lru_push_front(Sim *s, int f) {
+    Frame *fr = &s->frames[f];
+    fr->prev = -1;
+    fr->next = s->lru_head;
+    if (s->lru_head >= 0) s->frames[s->lru_head].prev = f;
+    s->lru_head = f;
+    if (s->lru_tail < 0) s->lru_tail = f;
+}
+
+// OPT max-heap keyed by next_use
+
+static void heap_swap(Sim *s, int i, int j) {
+    int a = s->heap[i], b = s->heap[j];
+    s->heap[i] = b;
+    s->heap[j] = a;
+    s->frames[b].heap_pos = i;
+    s->frames[a].heap_pos = j;
+}
+
+static void heap_fix(Sim *s, int i) {
+    // sift up
+    while (i > 0) {
+        int p = (i - 1) / 2;
+        if (s->frames[s->heap[p]].next_use >= s->frames[s->heap[i]].next_use) break;
+        heap_swap(s, i, p);
+        i = p;
+    }
+    // sift down
+    for (;;) {
+        int l = 2 * i + 1, r = l + 1, m = i;
+        if (l < s->heap_n && s->frames[s->heap[l]].next_use > s->frames[s->heap[m]].next_use) m = l;
+        if (r < s->heap_n && s->frames[s->heap[r]].next_use > s->frames[s->heap[m]].next_use) m = r;
+        if (m == i) break;
+        heap_swap(s, i, m);
+        i = m;
+    }
+}
+
+// record a reference to frame f for the replacement policy
+static void frame_touch(Sim *s, int f, int write) {
+    Frame *fr = &s->frames[f];
+    fr->ref = 1;
+    fr->last_use = s->now;
+    if (write) fr->dirty = 1;
+
+    if (s->cfg.policy == POL_LRU) {
+        lru_unlink(s, f);
+        lru_push_front(s, f);
+    } else if (s->cfg.policy == POL_OPT) {
+        fr->next_use = s->next_use[s->now];
+        heap_fix(s, fr->heap_pos);
+    }
+}
+
+static int pick_victim(Sim *s) {
+    int n = s->nframes;
+    int f;
+
+    switch (s->cfg.policy) {
+    case POL_LRU:
+        return s->lru_tail;
+
+    case POL_OPT:
+        // the page used furthest in the future (or never again)
+        return s->heap[0];
+
+    case POL_CLOCK:
+        for (;;) {
+            f = s->hand;
+            s->hand = (s->hand + 1) % n;
+            if (!s->frames[f].ref) return f;
+            s->frames[f].ref = 0;
+        }
+
+    case POL_WSCLOCK: {
+        int clean = -1;
+        for (int step = 0; step < 2 * n; step++) {
+            f = s->hand;
+            Frame *fr = &s->frames[f];
+            s->hand = (s->hand + 1) % n;
+
+            if (fr->ref) {
+                fr->ref = 0;
+                fr->last_use = s->now;
+                continue;
+            }
+            if (s->now - fr->last_use > s->cfg.ws_tau) {
+                if (!fr->dirty) return f;
+                // schedule the write; the page is clean when the hand returns
+                fr->dirty = 0;
+                s->writebacks++;
+                continue;
+            }
+            if (clean < 0 && !fr->dirty) clean = f;
+        }
+        // nothing outside the working set: any clean page, else the hand
+        if (clean >= 0) return clean;
+        f = s->hand;
+        s->hand = (s->hand + 1) % n;
+        return f;
+    }
+
+    default:
+        // FIFO: frames are refilled in place, so load order is round robin
+        f = s->hand;
+        s->hand = (s->hand + 1) % n;
+        return f;
+    }
+}
+
+// unmap whatever lives in frame f
+static void evict(Sim *s, int f, Access *a) {
+    Frame *fr = &s->frames[f];
+    AddrSpace *sp = &s->spaces[fr->space];
+
+    table_unmap(s, sp, fr->vpn);
+
+    // stale translations must go; without ASIDs only the running process
+    // can have any
+    if (s->cfg.asid || sp == s->cur) {
+        for (int i = 0; i < s->cfg.ntlb; i++) {
+            tlb_invalidate(&s->tlb[i], s->cfg.asid ? sp->pid : 0, fr->vpn);
+        }
+    }
+
+    if (fr->dirty) s->writebacks++;
+    s->evictions++;
+    a->evicted = 1;
+    a->victim_pid = sp->pid;
+    a->victim_vpn = fr->vpn;
+}
+
+// find a frame for a page that is not resident
+static uint64_t sim_fault(Sim *s, AddrSpace *sp, uint64_t vpn, Access *a) {
+    s->faults++;
+    a->fault = 1;
+
+    if (!s->nframes) return frame_new(s);
+
+    int f;
+    if (s->used_frames < s->nframes) {
+        f = s->used_frames++;
+        if (s->cfg.policy == POL_OPT) {
+            s->heap[s->heap_n] = f;
+            s->frames[f].heap_pos = s->heap_n++;
+        }
+    } else {
+        f = pick_victim(s);
+        evict(s, f, a);
+    }
+
+    Frame *fr = &s->frames[f];
+    fr->space = (int)(sp - s->spaces);
+    fr->vpn = vpn;
+    fr->ref = 0;
+    fr->dirty = 0;
+    return (uint64_t)f;
+}
+
+// ---------------- fork and copy-on-write ----------------
+
+// "fork:P:C" gives C a copy of P's page table pointing at the same frames,
+// both sides marked PTE_COW, and every such frame counts its extra
+// mappings in sharers[]. A write to a PTE_COW page copies the frame, or
+// just takes it back writable when nobody else maps it any more. "exit:P"
+// drops P's mappings; a frame is free once its last mapping goes.
+//
+// TLB entries carry no permission bits here. A fork flushes the parent's
+// entries and a COW fault replaces the one entry, so any cached
+// translation of a PTE_COW page is a read-only one, and a write that hits
+// it checks the PTE the way the hardware would fault on the missing write
+// permission.
+//
+// Events need unlimited memory, base pages only and a per-process table;
+// otherwise they are counted and skipped.
+
+static uint64_t *table_pte(Sim *s, AddrSpace *sp, uint64_t vpn) {
+    if (s->cfg.table == TABLE_HASHED) {
+        HashNode *n = hash_find(&sp->ht, vpn, NULL);
+        return n ? &n->pte : NULL;
+    }
+    return radix_walk(&sp->pt, vpn, 0, NULL);
+}
+
+static void space_leaves(Sim *s, AddrSpace *sp, LeafFn fn, void *ctx) {
+    if (s->cfg.table == TABLE_HASHED) hash_leaves(&sp->ht, fn, ctx);
+    else radix_leaves(&sp->pt, sp->pt.root, 0, 0, fn, ctx);
+}
+
+static inline uint32_t frame_sharers(const Sim *s, uint64_t f) {
+    return f < s->cap_sharers ? s->sharers[f] : 0;
+}
+
+// translations of one process are stale (or too permissive)
+static void tlb_drop_space(Sim *s, const AddrSpace *sp) {
+    for (int i = 0; i < s->cfg.ntlb; i++) {
+        if (s->cfg.asid) tlb_flush_asid(&s->tlb[i], sp->pid);
+        else if (sp == s->cur) tlb_flush(&s->tlb[i]);
+    }
+}
+
+typedef struct {
+    Sim *s;
+    AddrSpace *child;
+} ForkCtx;
+
+static void fork_leaf(void *ctx, uint64_t vpn, uint64_t *pte) {
+    ForkCtx *fc = ctx;
+    uint64_t f = *pte >> PTE_FRAME_SHIFT;
+
+    *pte |= PTE_COW;
+    table_map(fc->s, fc->child, vpn, f);
+    *table_pte(fc->s, fc->child, vpn) |= PTE_COW;
+    fc->s->sharers[f]++;
+    fc->s->shared++;
+    fc->s->fork_pages++;
+}
+
+static void exit_leaf(void *ctx, uint64_t vpn, uint64_t *pte) {
+    Sim *s = ctx;
+    uint64_t f = *pte >> PTE_FRAME_SHIFT;
+    (void)vpn;
+
+    if (frame_sharers(s, f)) {
+        s->sharers[f]--;
+        s->shared--;
+    } else {
+        frame_free(s, f, 0);
+    }
+}
+
+static AddrSpace *sim_find(Sim *s, uint32_t pid) {
+    for (int i = 0; i < s->nspaces; i++) {
+        if (s->spaces[i].pid == pid) return &s->spaces[i];
+    }
+    return NULL;
+}
+
+static void sim_exit(Sim *s, uint32_t pid) {
+    AddrSpace *sp = sim_find(s, pid);
+    if (!sp) return;
+
+    space_leaves(s, sp, exit_leaf, s);
+    tlb_drop_space(s, sp);
+    if (s->cfg.table == TABLE_RADIX) radix_destroy(&sp->pt);
+    else hash_destroy(&sp->ht);
+
+    // the last space moves into the hole
+    AddrSpace *last = &s->spaces[--s->nspaces];
+    if (s->cur == sp) s->cur = NULL;
+    if (sp != last) {
+        *sp = *last;
+        if (s->cur == last) s->cur = sp;
+    }
+    s->exits++;
+}
+
+static void sim_fork(Sim *s, uint32_t parent, uint32_t child) {
+    if (parent == child) return;
+    sim_exit(s, child);     // a reused pid starts over
+
+    // sim_space may move the array, so the parent is found again by index
+    int pi = (int)(sim_space(s, parent) - s->spaces);
+    AddrSpace *c = sim_space(s, child);
+    AddrSpace *p = &s->spaces[pi];
+
+    uint64_t top = s->mem.buddy.nframes ? s->mem.buddy.nframes : s->next_frame;
+    if (s->cap_sharers < top) {
+        uint64_t ncap = s->cap_sharers ? s->cap_sharers : 1024;
+        while (ncap < top) ncap *= 2;
+        uint32_t *ns = realloc(s->sharers, ncap * sizeof(uint32_t));
+        if (!ns) {
+            perror("realloc");
+            exit(1);
+        }
+        memset(ns + s->cap_sharers, 0, (ncap - s->cap_sharers) * sizeof(uint32_t));
+        s->sharers = ns;
+        s->cap_sharers = ncap;
+    }
+
+    ForkCtx fc = {s, c};
+    space_leaves(s, p, fork_leaf, &fc);
+    tlb_drop_space(s, p);
+    if (s->shared > s->peak_shared) s->peak_shared = s->shared;
+    s->forks++;
+}
+
+static void sim_event(Sim *s, const Ref *r) {
+    if (s->nframes || s->cfg.huge_levels || s->cfg.table == TABLE_INVERTED) {
+        if (!s->events_ignored++) {
+            fprintf(stderr, "fork/exit events need unlimited memory, base pages and a radix "
+                            "or hashed table; skipping them\n");
+        }
+        return;
+    }
+    if (r->flags & REF_FORK) sim_fork(s, r->pid, (uint32_t)r->addr);
+    else sim_exit(s, r->pid);
+}
+
+// a write reached a page: break copy-on-write sharing if it is marked
+static void cow_write(Sim *s, AddrSpace *sp, uint32_t asid, Access *a) {
+    uint64_t *pte = table_pte(s, sp, a->vpn);
+    if (!pte || !(*pte & PTE_COW)) return;
+
+    s->cow_faults++;
+    if (frame_sharers(s, a->frame)) {
+        s->sharers[a->frame]--;
+        s->shared--;
+        a->frame = frame_new(s);
+        *pte = (a->frame << PTE_FRAME_SHIFT) | PTE_PRESENT;
+        s->cow_copies++;
+        a->cow = COW_COPY;
+    } else {
+        *pte &= ~PTE_COW;
+        s->cow_reuses++;
+        a->cow = COW_REUSE;
+    }
+
+    for (int i = 0; i < s->cfg.ntlb; i++) {
+        tlb_invalidate(&s->tlb[i], asid, a->vpn);
+        tlb_fill(&s->tlb[i], asid, a->vpn, a->frame, 0);
+    }
+}
+
+// translate one reference; index is its position in the trace
+static void sim_access(Sim *s, const Ref *r, uint64_t index, Access *a) {
+    const Config *cfg = &s->cfg;
+    if (r->flags & REF_EVENT) {
+        sim_event(s, r);
+        return;
+    }
+    AddrSpace *sp = sim_space(s, r->pid);
+
+    // a context switch without ASIDs throws the whole TLB away
+    if (s->cur && s->cur != sp) {
+        s->switches++;
+        if (!cfg->asid) {
+            for (int i = 0; i < cfg->ntlb; i++) tlb_flush(&s->tlb[i]);
+        }
+    }
+    s->cur = sp;
+    s->now = index;
+
+    uint32_t asid = cfg->asid ? r->pid : 0;
+    a->vpn = r->addr >> cfg->page_shift;
+    a->offset = r->addr & ((1ULL << cfg->page_shift) - 1);
+    a->tlb_level = 0;
+    a->order = 0;
+    a->refs = 0;
+    a->fault = 0;
+    a->cow = COW_NONE;
+    a->evicted = 0;
+    s->translations++;
+
+    for (int i = 0; i < cfg->ntlb; i++) {
+        s->cycles += (uint64_t)cfg->tlb_cycles[i];
+        if (tlb_lookup(&s->tlb[i], asid, a->vpn, &a->frame, &a->order)) {
+            a->tlb_level = i + 1;
+            // refill the levels above
+            for (int j = 0; j < i; j++) tlb_fill(&s->tlb[j], asid, a->vpn, a->frame, a->order);
+            break;
+        }
+    }
+
+    if (a->tlb_level == 0) {
+        if (cfg->huge_levels) {
+            huge_access(s, sp, a);
+        } else if (!table_lookup(s, sp, a->vpn, &a->frame, &a->refs)) {
+            a->frame = sim_fault(s, sp, a->vpn, a);
+            table_map(s, sp, a->vpn, a->frame);
+        }
+
+        s->walks++;
+        s->walk_refs += (uint64_t)a->refs;
+        s->cycles += (uint64_t)a->refs * (uint64_t)cfg->walk_cycles;
+        for (int i = 0; i < cfg->ntlb; i++) tlb_fill(&s->tlb[i], asid, a->vpn, a->frame, a->order);
+    }
+
+    if (s->forks && (r->flags & REF_WRITE)) cow_write(s, sp, asid, a);
+    if (s->nframes) frame_touch(s, (int)a->frame, r->flags & REF_WRITE);
+    a->physical = (a->frame << cfg->page_shift) | a->offset;
+    if (s->caches.n) cache_access(&s->caches, a->physical, r->flags & REF_WRITE);
+}
+
+// translate a batch. Without TLBs or a frame limit every reference is a
+// full walk, so a repeat of the previous page reuses its frame and is
+// counted exactly as the walk would have been.
+static void sim_batch(Sim *s, const Ref *r, size_t n, uint64_t index, Access *out) {
+    const Config *cfg = &s->cfg;
+    size_t i = 0;
+
+    // process events and copy-on-write pages need every reference seen, and
+    // a promotion moves frames the batch kernel already handed out
+    int events = 0;
+    for (size_t k = 0; k < n; k++) events |= (int)(r[k].flags & REF_EVENT);
+
+    if (cfg->ntlb || s->nframes || s->caches.n || s->forks || events ||
+        (cfg->huge_levels && cfg->promote_pct)) {
+        for (; i < n; i++) sim_access(s, &r[i], index + i, &out[i]);
+        return;
+    }
+
+    // one process for the whole batch: runs of references to the same page
+    // are collapsed, the batch kernel translates one address per run and
+    // only the unmapped pages go through sim_access, in trace order
+    if (s->cur && n > 0 && cfg->table == TABLE_RADIX) {
+        uint32_t pid = s->cur->pid;
+        while (i < n && r[i].pid == pid) i++;
+        if (i == n) {
+            int shift = cfg->page_shift;
+            uint64_t mask = (1ULL << shift) - 1;
+            uint64_t head[BATCH], pa[BATCH];
+            size_t runs = 0;
+
+            for (i = 0; i < n; i++) {
+                uint64_t page = r[i].addr & ~mask;
+                if (runs == 0 || head[runs - 1] != page) head[runs++] = page;
+            }
+            s->xlate(&s->cur->pt, head, pa, runs);
+
+            // with huge pages the leaf of each run sets its order and
+            // walk length; otherwise every walk goes all the way down
+            uint64_t hits = 0, hit_refs = 0;
+            int order = 0, refs = cfg->levels, level;
+            size_t k = 0;
+            for (i = 0; i < n; i++) {
+                Access *a = &out[i];
+                int new_run = i == 0 || (r[i].addr & ~mask) != (r[i - 1].addr & ~mask);
+                int faulted = 0;
+                if (i > 0 && new_run) k++;
+                if (pa[k] == XLATE_FAULT) {
+                    // maps the page; the rest of the run reuses the frame
+                    sim_access(s, &r[i], index + i, a);
+                    pa[k] = a->frame << shift;
+                    new_run = faulted = 1;
+                }
+                if (new_run && cfg->huge_levels) {
+                    radix_walk_to(&s->cur->pt, r[i].addr >> shift, cfg->levels - 1, 0, &refs, &level);
+                    order = level_order(cfg, level);
+                }
+                if (faulted) continue;
+                a->vpn = r[i].addr >> shift;
+                a->offset = r[i].addr & mask;
+                a->frame = pa[k] >> shift;
+                a->physical = pa[k] | a->offset;
+                a->tlb_level = 0;
+                a->order = order;
+                a->refs = refs;
+                a->fault = 0;
+                a->cow = COW_NONE;
+                a->evicted = 0;
+                hits++;
+                hit_refs += (uint64_t)refs;
+            }
+            s->translations += hits;
+            s->walks += hits;
+            s->walk_refs += hit_refs;
+            s->cycles += hit_refs * (uint64_t)cfg->walk_cycles;
+            return;
+        }
+        i = 0;
+    }
+
+    // the previous page lives in locals so the repeat path never reloads
+    // the Access it just wrote
+    int shift = cfg->page_shift;
+    uint64_t mask = (1ULL << shift) - 1;
+    uint64_t last_vpn = 0, last_frame = 0, repeats = 0, repeat_refs = 0;
+    uint32_t last_pid = 0;
+    int last_refs = 0, last_order = 0, have_last = 0;
+
+    for (; i < n; i++) {
+        Access *a = &out[i];
+        uint64_t vpn = r[i].addr >> shift;
+        if (have_last && vpn == last_vpn && r[i].pid == last_pid) {
+            a->vpn = vpn;
+            a->offset = r[i].addr & mask;
+            a->frame = last_frame;
+            a->physical = (last_frame << shift) | a->offset;
+            a->tlb_level = 0;
+            a->order = last_order;
+            a->refs = last_refs;
+            a->fault = 0;
+            a->cow = COW_NONE;
+            a->evicted = 0;
+            repeats++;
+            repeat_refs += (uint64_t)last_refs;
+            continue;
+        }
+        sim_access(s, &r[i], index + i, a);
+        last_vpn = vpn;
+        last_pid = r[i].pid;
+        last_frame = a->frame;
+        last_refs = a->refs;
+        last_order = a->order;
+        have_last = 1;
+    }
+
+    // every repeat is a full walk costing what the previous one did
+    s->translations += repeats;
+    s->walks += repeats;
+    s->walk_refs += repeat_refs;
+    s->cycles += repeat_refs * (uint64_t)cfg->walk_cycles;
+}
 
-#define PAGE_SIZE 1024
-#define NUM_PAGES 4
+// ---------------- reporting ----------------
+
+static void print_bytes(uint64_t b) {
+    const char *unit[] = {"B", "KiB", "MiB", "GiB", "TiB", "PiB", "EiB"};
+    double v = (double)b;
+    int u = 0;
+    while (v >= 1024.0 && u < 6) {
+        v /= 1024.0;
+        u++;
+    }
+    if (u == 0) printf("%llu B", (unsigned long long)b);
+    else printf("%.2f %s", v, unit[u]);
+}
+
+static const char *policy_name(int p) {
+    return p == REPL_FIFO ? "fifo" : p == REPL_RANDOM ? "random" : "lru";
+}
+
+static void print_config(const Config *cfg) {
+    if (cfg->table == TABLE_HASHED) {
+        printf("hashed page table (chained)");
+    } else if (cfg->table == TABLE_INVERTED) {
+        printf("inverted page table (cuckoo hashed)");
+    } else {
+        printf("%d-level page table | bits ", cfg->levels);
+        for (int i = 0; i < cfg->levels; i++) printf(i ? "/%d" : "%d", cfg->bits[i]);
+    }
+    printf(" | page size ");
+    print_bytes(1ULL << cfg->page_shift);
+    printf(" | %d-bit VA | %d-byte PTEs\n", cfg->va_bits, cfg->pte_size);
+
+    for (int i = 0; i < cfg->ntlb; i++) {
+        const TlbSpec *t = &cfg->tlb[i];
+        printf("L%d TLB: %d entries, %d-way, %s, %d cycles\n", i + 1, t->entries, t->ways,
+               policy_name(t->policy), cfg->tlb_cycles[i]);
+    }
+    for (int i = 0; i < cfg->ncache; i++) {
+        const CacheSpec *c = &cfg->cache[i];
+        printf("L%d cache: ", i + 1);
+        print_bytes(c->size);
+        printf(", %d-way, %d-byte lines, %llu sets, %s\n", c->ways, c->line,
+               (unsigned long long)(c->size / ((uint64_t)c->ways * (uint64_t)c->line)),
+               g_cache_modes[cfg->cache_mode]);
+    }
+}
+
+static void print_access(const Sim *s, uint32_t pid, uint64_t addr, const Access *a) {
+    const Config *cfg = &s->cfg;
+    static const char *tlb_str[] = {"miss", "L1 hit", "L2 hit"};
+
+    if (s->nspaces > 1 || pid) printf("PID: %u | ", pid);
+    printf("Logical: 0x%llx | Page: 0x%llx | Offset: %llu",
+           (unsigned long long)addr, (unsigned long long)a->vpn, (unsigned long long)a->offset);
+    if (a->tlb_level == 0 && cfg->table == TABLE_RADIX) {
+        printf(" | Index:");
+        for (int l = 0; l < cfg->levels && level_order(cfg, l) >= a->order; l++) {
+            printf(l ? "/%zu" : " %zu", radix_index(cfg, a->vpn, l));
+        }
+    } else if (a->tlb_level == 0) {
+        printf(" | Refs: %d", a->refs);
+    }
+    printf(" | Frame: %llu | Physical: 0x%llx",
+           (unsigned long long)a->frame, (unsigned long long)a->physical);
+    if (cfg->ntlb) printf(" | TLB: %s", tlb_str[a->tlb_level]);
+    if (cfg->huge_levels) {
+        printf(" | Size: ");
+        print_bytes(1ULL << (cfg->page_shift + a->order));
+    }
+    if (a->fault && s->nframes) {
+        printf(" | FAULT");
+        if (a->evicted) {
+            printf(" (evicted ");
+            if (s->nspaces > 1 || a->victim_pid) printf("%u:", a->victim_pid);
+            printf("page 0x%llx)", (unsigned long long)a->victim_vpn);
+        }
+    } else if (a->fault) {
+        printf(" (new)");
+    }
+    if (a->cow) printf(" | COW %s", a->cow == COW_COPY ? "copy" : "reuse");
+    printf("\n");
+}
+
+static void print_event(const Ref *r) {
+    if (r->flags & REF_FORK) printf("PID: %u | fork -> PID %llu\n", r->pid, (unsigned long long)r->addr);
+    else printf("PID: %u | exit\n", r->pid);
+}
+
+// bytes of table a fully mapped region under one entry of this level
+// would take with base pages only
+static uint64_t subtree_bytes(const Config *cfg, int level) {
+    uint64_t nodes = 1, bytes = 0;
+    for (int l = level + 1; l < cfg->levels; l++) {
+        bytes += nodes * ((uint64_t)1 << cfg->bits[l]) * (uint64_t)cfg->pte_size;
+        nodes <<= cfg->bits[l];
+    }
+    return bytes;
+}
+
+static void print_cache_summary(const Sim *s) {
+    const CacheHier *h = &s->caches;
+    uint64_t refs = h->c[0].accesses;
+
+    printf("\n--- Cache summary (%s, write-back) ---\n", g_cache_modes[h->mode]);
+    for (int i = 0; i < h->n; i++) {
+        const Cache *c = &h->c[i];
+        uint64_t misses = c->accesses - c->hits;
+        printf("L%d: %llu accesses | %llu misses | local miss rate %.2f%% | global %.2f%% | "
+               "writebacks %llu", i + 1, (unsigned long long)c->accesses, (unsigned long long)misses,
+               c->accesses ? 100.0 * (double)misses / (double)c->accesses : 0.0,
+               refs ? 100.0 * (double)misses / (double)refs : 0.0,
+               (unsigned long long)c->writebacks);
+        if (h->mode == CACHE_INCLUSIVE && i > 0) {
+            printf(" | back-invalidations %llu", (unsigned long long)c->back_invals);
+        }
+        printf("\n");
+    }
+    printf("Memory: %llu line reads, %llu line writebacks (",
+           (unsigned long long)h->mem_reads, (unsigned long long)h->mem_writes);
+    print_bytes((h->mem_reads + h->mem_writes) << h->line_shift);
+    printf(")\n");
+
+    // a frame's color picks which slice of a level's sets it can use
+    printf("Page colors:");
+    for (int i = 0; i < h->n; i++) {
+        uint64_t way_bytes = h->c[i].sets << h->line_shift;
+        uint64_t colors = way_bytes >> s->cfg.page_shift;
+        printf(" L%d=%llu", i + 1, (unsigned long long)(colors ? colors : 1));
+    }
+    printf("\n");
+}
+
+static void print_memory_summary(const Sim *s) {
+    const Config *cfg = &s->cfg;
+    const PhysMem *m = &s->mem;
+    const Buddy *b = &m->buddy;
+    uint64_t used = b->nframes - b->free_frames;
+
+    printf("\n--- Physical memory summary ---\n");
+    printf("Buddy allocator: ");
+    print_bytes(b->nframes << cfg->page_shift);
+    printf(" (%llu frames, max order %d) | in use: %llu frames (%.2f%%), %llu for pages, "
+           "%llu for page tables\n",
+           (unsigned long long)b->nframes, b->max_order, (unsigned long long)used,
+           100.0 * (double)used / (double)b->nframes, (unsigned long long)s->user_frames,
+           (unsigned long long)(used - s->user_frames));
+    printf("Allocations: %llu (%.3f splits avg, %llu max) | frees: %llu (%.3f merges avg) | "
+           "failed: %llu\n",
+           (unsigned long long)b->allocs, b->allocs ? (double)b->splits / (double)b->allocs : 0.0,
+           (unsigned long long)b->max_splits, (unsigned long long)b->frees,
+           b->frees ? (double)b->merges / (double)b->frees : 0.0, (unsigned long long)b->failed);
+    if (cfg->huge_levels) {
+        printf("Huge pages not available (fell back to smaller pages or stayed unpromoted): %llu\n",
+               (unsigned long long)s->huge_failed);
+    }
+
+    printf("Free blocks by order:");
+    int largest = -1;
+    for (int o = 0; o <= b->max_order; o++) {
+        if (b->blocks[o]) largest = o;
+        if (b->blocks[o]) printf(" %d:%llu", o, (unsigned long long)b->blocks[o]);
+    }
+    printf("\nLargest free block: ");
+    if (largest >= 0) print_bytes(1ULL << (largest + cfg->page_shift));
+    else printf("none");
+
+    // Gorman's unusable free space index at each table level's page size
+    printf(" | unusable free space:");
+    for (int l = 0; l < cfg->levels - 1; l++) {
+        int order = level_order(cfg, l);
+        if (order > b->max_order) continue;
+        printf(" ");
+        print_bytes(1ULL << (order + cfg->page_shift));
+        printf(" %.1f%%", 100.0 * buddy_unusable(b, order));
+    }
+    printf("\n");
+
+    if (m->ncaches) {
+        printf("Slab caches for page tables:\n");
+        printf("  %10s %9s %10s %8s %10s %8s\n", "object", "per slab", "slab", "slabs", "objects", "used");
+        for (int i = 0; i < m->ncaches; i++) {
+            const SlabCache *c = &m->cache[i];
+            uint64_t room = c->live_slabs * c->per_slab;
+            printf("  %8u B %9u %7llu KiB %8llu %10llu %7.1f%%\n", c->size, c->per_slab,
+                   (unsigned long long)((1ULL << (c->order + cfg->page_shift)) >> 10),
+                   (unsigned long long)c->live_slabs, (unsigned long long)c->objects,
+                   room ? 100.0 * (double)c->objects / (double)room : 0.0);
+        }
+    }
+}
+
+static void print_huge_summary(const Sim *s) {
+    const Config *cfg = &s->cfg;
+    uint64_t base = 0, saved = 0;
+
+    printf("\n--- Huge page summary ---\n");
+    printf("Promotion: ");
+    if (cfg->promote_pct) printf("collapse at %d%% mapped\n", cfg->promote_pct);
+    else printf("eager\n");
+
+    for (int l = cfg->levels - 1; l >= 0; l--) {
+        if (l != cfg->levels - 1 && !(cfg->huge_levels >> l & 1)) continue;
+        uint64_t pages = (uint64_t)1 << level_order(cfg, l);
+        printf("  ");
+        print_bytes(pages << cfg->page_shift);
+        printf(" pages: %llu mapped", (unsigned long long)s->leaves[l]);
+        if (l != cfg->levels - 1) printf(", %llu by promotion", (unsigned long long)s->promotions[l]);
+        printf("\n");
+        base += s->leaves[l] * pages;
+        if (l != cfg->levels - 1) saved += s->leaves[l] * subtree_bytes(cfg, l);
+    }
+
+    printf("Memory mapped: ");
+    print_bytes(base << cfg->page_shift);
+    if (s->copied) {
+        printf(" | copied by promotion: ");
+        print_bytes(s->copied << cfg->page_shift);
+    }
+    printf("\nPage table memory saved: ");
+    print_bytes(saved);
+    printf(" (vs. base pages mapping the same memory)\n");
+
+    for (int i = 0; i < cfg->ntlb; i++) {
+        const Tlb *t = &s->tlb[i];
+        uint64_t reach = 0;
+        for (int e = 0; e < t->spec.entries; e++) {
+            if (t->e[e].valid) reach += (uint64_t)1 << t->e[e].order;
+        }
+        printf("L%d TLB reach: ", i + 1);
+        print_bytes(reach << cfg->page_shift);
+        printf(" (base pages only: ");
+        print_bytes((uint64_t)t->spec.entries << cfg->page_shift);
+        printf(")\n");
+    }
+}
+
+static void print_summary(const Sim *s) {
+    const Config *cfg = &s->cfg;
+    uint64_t nodes[MAX_LEVELS] = {0};
+    uint64_t table_bytes = 0, mapped = 0, buckets = 0;
+
+    for (int i = 0; i < s->nspaces; i++) {
+        const AddrSpace *sp = &s->spaces[i];
+        if (cfg->table == TABLE_RADIX) {
+            for (int l = 0; l < cfg->levels; l++) nodes[l] += sp->pt.nodes[l];
+            table_bytes += radix_memory(&sp->pt);
+            mapped += sp->pt.mapped;
+        } else if (cfg->table == TABLE_HASHED) {
+            table_bytes += hash_memory(&sp->ht);
+            mapped += sp->ht.count;
+            buckets += sp->ht.nbuckets;
+        }
+    }
+    if (cfg->table == TABLE_INVERTED) {
+        table_bytes = inv_memory(&s->inv);
+        mapped = s->inv.count;
+    }
+
+    printf("\n--- Page table summary ---\n");
+    print_config(cfg);
+    printf("Translations: %llu | invalid: %llu | pages mapped: %llu | processes: %d\n",
+           (unsigned long long)s->translations + s->invalid, (unsigned long long)s->invalid,
+           (unsigned long long)mapped, s->nspaces);
+
+    if (cfg->table == TABLE_HASHED) {
+        printf("Hashed page table: %llu buckets, %llu chain nodes, load factor %.2f\n",
+               (unsigned long long)buckets, (unsigned long long)mapped,
+               buckets ? (double)mapped / (double)buckets : 0.0);
+    } else if (cfg->table == TABLE_INVERTED) {
+        printf("Inverted page table: %llu entries (one per frame) | cuckoo 2 x %zu slots, "
+               "load %.2f, %llu kicks, %llu rehashes\n",
+               (unsigned long long)s->inv.nipt, s->inv.cap,
+               (double)s->inv.count / (double)(2 * s->inv.cap),
+               (unsigned long long)s->inv.kicks, (unsigned long long)s->inv.rehashes);
+    } else {
+        printf("Nodes per level:");
+        for (int l = 0; l < cfg->levels; l++) {
+            printf(" L%d=%llu", l + 1, (unsigned long long)nodes[l]);
+        }
+        printf("\n");
+    }
+
+    printf("Page table memory: ");
+    print_bytes(table_bytes);
+    printf(" (a flat table would need ");
+    int vpn_bits = cfg->va_bits - cfg->page_shift;
+    if (vpn_bits + 3 >= 64) printf("2^%d entries", vpn_bits);
+    else print_bytes(((uint64_t)1 << vpn_bits) * (uint64_t)cfg->pte_size);
+    printf(s->nspaces > 1 ? " per process)\n" : ")\n");
+
+    if (mapped) {
+        printf("Table bytes per mapped page: %.1f\n", (double)table_bytes / (double)mapped);
+    }
+    if (cfg->table == TABLE_RADIX) printf("Walk cost: %d memory references per translation", cfg->levels);
+    else printf("Walk cost: %s lookup", cfg->table == TABLE_HASHED ? "hash chain" : "cuckoo + IPT");
+    if (s->walks) {
+        printf(" (%llu walks, avg %.2f refs)", (unsigned long long)s->walks,
+               (double)s->walk_refs / (double)s->walks);
+    }
+    printf("\n");
+
+    if (cfg->ntlb && s->translations) {
+        printf("\n--- TLB summary ---\n");
+        for (int i = 0; i < cfg->ntlb; i++) {
+            const Tlb *t = &s->tlb[i];
+            printf("L%d TLB: %llu lookups | %llu hits | hit rate %.2f%% | flushes %llu\n", i + 1,
+                   (unsigned long long)t->lookups, (unsigned long long)t->hits,
+                   t->lookups ? 100.0 * (double)t->hits / (double)t->lookups : 0.0,
+                   (unsigned long long)t->flushes);
+        }
+        printf("Overall TLB hit rate: %.2f%% | context switches: %llu (%s)\n",
+               100.0 * (double)(s->translations - s->walks) / (double)s->translations,
+               (unsigned long long)s->switches, cfg->asid ? "ASID tagged" : "flush on switch");
+    }
+    if (s->translations) {
+        printf("Average translation cost: %.2f cycles (walk reference = %d cycles)\n",
+               (double)s->cycles / (double)s->translations, cfg->walk_cycles);
+    }
+
+    if (cfg->huge_levels) print_huge_summary(s);
+
+    if (s->caches.n) print_cache_summary(s);
+    if (s->mem.buddy.nframes) print_memory_summary(s);
+
+    if (s->forks || s->exits) {
+        uint64_t live = s->user_frames;
+        printf("\n--- Fork / copy-on-write summary ---\n");
+        printf("Forks: %llu (%llu pages shared) | exits: %llu | live processes: %d\n",
+               (unsigned long long)s->forks, (unsigned long long)s->fork_pages,
+               (unsigned long long)s->exits, s->nspaces);
+        printf("COW faults: %llu (%.3f%% of references) | copied: %llu | last sharer reused: %llu\n",
+               (unsigned long long)s->cow_faults,
+               s->translations ? 100.0 * (double)s->cow_faults / (double)s->translations : 0.0,
+               (unsigned long long)s->cow_copies, (unsigned long long)s->cow_reuses);
+        printf("Frames in use: %llu for %llu mappings | saved by sharing: %llu (",
+               (unsigned long long)live, (unsigned long long)(live + s->shared),
+               (unsigned long long)s->shared);
+        print_bytes(s->shared << cfg->page_shift);
+        printf(") | peak saved: %llu (", (unsigned long long)s->peak_shared);
+        print_bytes(s->peak_shared << cfg->page_shift);
+        printf(")\n");
+    }
+    if (s->events_ignored) {
+        printf("Process events skipped: %llu\n", (unsigned long long)s->events_ignored);
+    }
+
+    if (s->nframes) {
+        printf("\n--- Paging summary ---\n");
+        printf("Frames: %d | policy: %s", s->nframes, g_policy_names[cfg->policy]);
+        if (cfg->policy == POL_WSCLOCK) printf(" (tau %llu)", (unsigned long long)cfg->ws_tau);
+        printf("\nPage faults: %llu (%.2f%%) | evictions: %llu | dirty writebacks: %llu\n",
+               (unsigned long long)s->faults,
+               s->translations ? 100.0 * (double)s->faults / (double)s->translations : 0.0,
+               (unsigned long long)s->evictions, (unsigned long long)s->writebacks);
+    }
+}
+
+// one row of the --policy comparison table
+static void print_policy_row(const Sim *s) {
+    double n = s->translations ? (double)s->translations : 1.0;
+    printf("%-8s %12llu %9.2f%% %12llu %12llu %8.2f%% %10.2f\n",
+           g_policy_names[s->cfg.policy], (unsigned long long)s->faults,
+           100.0 * (double)s->faults / n, (unsigned long long)s->evictions,
+           (unsigned long long)s->writebacks,
+           s->cfg.ntlb ? 100.0 * (double)(s->translations - s->walks) / n : 0.0,
+           (double)s->cycles / n);
+}
+
+// compact per-address line for trace files: "[pid:]logical physical[ F|C]",
+// C for a copy-on-write fault; process events are echoed as they came
+static inline void out_access(OutBuf *o, const Ref *r, const Access *a) {
+    out_room(o, 64);
+    if (r->flags & REF_EVENT) {
+        memcpy(o->buf + o->n, r->flags & REF_FORK ? "fork:" : "exit:", 5);
+        o->n += 5;
+        out_dec(o, r->pid);
+        if (r->flags & REF_FORK) {
+            o->buf[o->n++] = ':';
+            out_dec(o, r->addr);
+        }
+        o->buf[o->n++] = '\n';
+        return;
+    }
+    if (r->pid) {
+        out_dec(o, r->pid);
+        o->buf[o->n++] = ':';
+    }
+    out_hex(o, r->addr);
+    o->buf[o->n++] = ' ';
+    out_hex(o, a->physical);
+    if (a->fault || a->cow) {
+        o->buf[o->n++] = ' ';
+        o->buf[o->n++] = a->fault ? 'F' : 'C';
+    }
+    o->buf[o->n++] = '\n';
+}
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+// replay a mapped trace batch by batch without holding it in memory
+static int run_stream(const Config *cfg, TraceReader *rd, OutBuf *out) {
+    static Ref refs[BATCH];
+    static Access acc[BATCH];
+    Sim s;
+    sim_init(&s, cfg, NULL);
+
+    double t0 = now_sec();
+    uint64_t index = 0;
+    size_t n;
+    while ((n = reader_next(rd, refs, BATCH)) > 0) {
+        sim_batch(&s, refs, n, index, acc);
+        if (out) {
+            for (size_t i = 0; i < n; i++) out_access(out, &refs[i], &acc[i]);
+        }
+        index += n;
+    }
+    if (out) out_flush(out);
+    double secs = now_sec() - t0;
+
+    s.invalid = rd->bad;
+    print_summary(&s);
+    printf("Replay: %llu references in %.3f s (%.1f M/s)\n", (unsigned long long)index, secs,
+           secs > 0 ? (double)index / secs / 1e6 : 0.0);
+    sim_destroy(&s);
+    return 0;
+}
+
+// ---------------- parallel replay ----------------
+
+// --threads N splits a mapped trace into rounds of SEG_BYTES per worker.
+// Each worker parses its own byte range. Then, by --shard:
+//
+//   chunk  translation is stateless apart from first-touch frame
+//          allocation, so workers list the pages their chunk touches
+//          first, the main thread assigns frames in chunk order (which is
+//          exactly serial first-touch order) and workers translate their
+//          chunks read-only with the batch kernel, output per chunk.
+//   pid    every worker runs a full simulator (TLBs, frame limit) over the
+//          processes with pid % N == its id, like processes pinned to cores.
+//          --frames is split between the workers so the machine's memory
+//          stays the same whatever N is.
+//
+// Per-worker counters are merged at the end.
+
+enum { SHARD_CHUNK, SHARD_PID };
+
+#define SEG_BYTES (16 << 20)
+
+// a page seen first at index of this worker's chunk
+typedef struct {
+    uint64_t vpn;
+    size_t index;
+    uint32_t pid;
+    int global;         // also the first touch of the whole trace
+} FirstTouch;
+
+typedef struct Worker {
+    int id, nworkers;
+    const Config *cfg;
+    pthread_t thread;
+
+    const char *p, *end;    // this worker's share of the round
+    Ref *refs;
+    size_t n, cap;
+    uint64_t bad;
+    uint64_t events;        // fork/exit events skipped
+
+    // chunk mode
+    FirstTouch *first;
+    size_t nfirst, cap_first;
+    const Sim *tables;      // page tables built by the main thread
+    OutBuf out;
+    uint64_t switches;
+
+    // pid mode
+    struct Worker *all;     // every worker's parsed references
+    Sim sim;
+    uint64_t index;         // trace index of the round's first reference
+} Worker;
+
+static void *worker_parse(void *arg) {
+    Worker *w = arg;
+    TraceReader rd = {w->p, w->end, w->cfg->trace_format, 0, w->cfg->va_bits};
+    size_t got;
+
+    w->n = 0;
+    for (;;) {
+        if (w->cap - w->n < BATCH) {
+            w->cap = w->cap ? w->cap * 2 : 1 << 16;
+            Ref *nr = realloc(w->refs, w->cap * sizeof(Ref));
+            if (!nr) {
+                perror("realloc");
+                exit(1);
+            }
+            w->refs = nr;
+        }
+        got = reader_next(&rd, w->refs + w->n, BATCH);
+        if (!got) break;
+
+        // workers see only part of the processes, so fork/exit is dropped
+        Ref *b = w->refs + w->n;
+        size_t k = 0;
+        for (size_t i = 0; i < got; i++) {
+            if (b[i].flags & REF_EVENT) w->events++;
+            else b[k++] = b[i];
+        }
+        w->n += k;
+    }
+    w->bad += rd.bad;
+
+    if (w->cfg->shard != SHARD_CHUNK) return NULL;
+
+    // first touches of this chunk, in order
+    PageMap seen;
+    pagemap_init(&seen, 1 << 12);
+    w->nfirst = 0;
+    for (size_t i = 0; i < w->n; i++) {
+        int created;
+        uint64_t vpn = w->refs[i].addr >> w->cfg->page_shift;
+        pagemap_get(&seen, w->refs[i].pid, vpn, &created);
+        if (!created) continue;
+
+        if (w->nfirst == w->cap_first) {
+            w->cap_first = w->cap_first ? w->cap_first * 2 : 1024;
+            FirstTouch *nf = realloc(w->first, w->cap_first * sizeof(FirstTouch));
+            if (!nf) {
+                perror("realloc");
+                exit(1);
+            }
+            w->first = nf;
+        }
+        FirstTouch *f = &w->first[w->nfirst++];
+        f->vpn = vpn;
+        f->pid = w->refs[i].pid;
+        f->index = i;
+        f->global = 0;
+    }
+    pagemap_destroy(&seen);
+    return NULL;
+}
+
+static const RadixTable *sim_table(const Sim *s, uint32_t pid) {
+    for (int i = 0; i < s->nspaces; i++) {
+        if (s->spaces[i].pid == pid) return &s->spaces[i].pt;
+    }
+    return NULL;
+}
+
+// chunk mode, phase two: every page is mapped by now
+static void *worker_translate(void *arg) {
+    Worker *w = arg;
+    const Config *cfg = w->cfg;
+    XlateFn xlate = w->tables->xlate;
+    uint64_t mask = (1ULL << cfg->page_shift) - 1;
+    uint64_t head[BATCH], pa[BATCH];
+    size_t next_first = 0;
+
+    w->switches = 0;
+    w->out.n = 0;
+    for (size_t i = 0; i < w->n;) {
+        // a run of one process, collapsed to one address per page
+        uint32_t pid = w->refs[i].pid;
+        const RadixTable *pt = sim_table(w->tables, pid);
+        size_t j = i, runs = 0;
+        while (j < w->n && w->refs[j].pid == pid) {
+            uint64_t page = w->refs[j].addr & ~mask;
+            if (runs == 0 || head[runs - 1] != page) {
+                if (runs == BATCH) break;
+                head[runs++] = page;
+            }
+            j++;
+        }
+        xlate(pt, head, pa, runs);
+        if (j < w->n && w->refs[j].pid != pid) w->switches++;
+
+        if (!cfg->quiet) {
+            size_t k = 0;
+            for (size_t x = i; x < j; x++) {
+                if (x > i && (w->refs[x].addr & ~mask) != (w->refs[x - 1].addr & ~mask)) k++;
+                Access a;
+                a.physical = pa[k] | (w->refs[x].addr & mask);
+                a.fault = 0;
+                a.cow = COW_NONE;
+                if (next_first < w->nfirst && w->first[next_first].index == x) {
+                    a.fault = w->first[next_first++].global;
+                }
+                out_access(&w->out, &w->refs[x], &a);
+            }
+        }
+        i = j;
+    }
+    return NULL;
+}
+
+// pid mode: this worker's processes across every worker's chunk, in order
+static void *worker_shard(void *arg) {
+    Worker *w = arg;
+    uint64_t index = w->index;
+
+    for (int c = 0; c < w->nworkers; c++) {
+        const Worker *src = &w->all[c];
+        for (size_t i = 0; i < src->n; i++, index++) {
+            const Ref *r = &src->refs[i];
+            if ((int)(r->pid % (uint32_t)w->nworkers) != w->id) continue;
+            Access a;
+            sim_access(&w->sim, r, index, &a);
+        }
+    }
+    return NULL;
+}
+
+static void run_workers(Worker *w, int n, void *(*fn)(void *)) {
+    for (int i = 0; i < n; i++) {
+        if (pthread_create(&w[i].thread, NULL, fn, &w[i]) != 0) {
+            perror("pthread_create");
+            exit(1);
+        }
+    }
+    for (int i = 0; i < n; i++) pthread_join(w[i].thread, NULL);
+}
+
+// fold a worker's simulator into dst; its page tables move over
+static void sim_merge(Sim *dst, Sim *src) {
+    for (int i = 0; i < src->nspaces; i++) {
+        if (dst->nspaces == dst->cap_spaces) {
+            dst->cap_spaces = dst->cap_spaces ? dst->cap_spaces * 2 : 8;
+            AddrSpace *ns = realloc(dst->spaces, (size_t)dst->cap_spaces * sizeof(AddrSpace));
+            if (!ns) {
+                perror("realloc");
+                exit(1);
+            }
+            dst->spaces = ns;
+        }
+        dst->spaces[dst->nspaces++] = src->spaces[i];
+    }
+    src->nspaces = 0;
+
+    for (int i = 0; i < dst->cfg.ntlb; i++) {
+        dst->tlb[i].lookups += src->tlb[i].lookups;
+        dst->tlb[i].hits += src->tlb[i].hits;
+        dst->tlb[i].flushes += src->tlb[i].flushes;
+    }
+    dst->translations += src->translations;
+    dst->invalid += src->invalid;
+    dst->walks += src->walks;
+    dst->walk_refs += src->walk_refs;
+    dst->faults += src->faults;
+    dst->evictions += src->evictions;
+    dst->writebacks += src->writebacks;
+    dst->switches += src->switches;
+    dst->cycles += src->cycles;
+    caches_merge(&dst->caches, &src->caches);
+}
+
+static int run_parallel(const Config *cfg, const char *map, size_t len) {
+    int nw = cfg->threads;
+    Worker *w = calloc((size_t)nw, sizeof(Worker));
+    if (!w) {
+        perror("calloc");
+        return 1;
+    }
 
-int main(void) {
+    Sim s;
+    sim_init(&s, cfg, NULL);
+    for (int i = 0; i < nw; i++) {
+        w[i].id = i;
+        w[i].nworkers = nw;
+        w[i].cfg = cfg;
+        w[i].tables = &s;
+        w[i].all = w;
+        out_init(&w[i].out, OUT_BUF, 1);
+        if (cfg->shard == SHARD_PID) {
+            // the first workers take the remainder
+            Config wc = *cfg;
+            wc.frames = cfg->frames / (uint64_t)nw + ((uint64_t)i < cfg->frames % (uint64_t)nw);
+            sim_init(&w[i].sim, &wc, NULL);
+        }
+    }
+
+    size_t rec = cfg->trace_format == FMT_BIN ? sizeof(uint64_t) :
+                 cfg->trace_format == FMT_REF ? sizeof(Ref) : 1;
+    const char *p = map, *end = map + len;
+    uint64_t index = 0, bad = 0;
+    uint32_t last_pid = 0;
+    int have_last = 0;
+    double t0 = now_sec();
+
+    while (p < end) {
+        // split the round at record / whitespace boundaries
+        const char *round = p;
+        for (int i = 0; i < nw; i++) {
+            const char *q = p + (size_t)(end - p < SEG_BYTES ? end - p : SEG_BYTES);
+            q = p + (size_t)(q - p) / rec * rec;
+            if (rec == 1) {
+                while (q < end && !is_space(*q)) q++;
+            }
+            w[i].p = p;
+            w[i].end = q;
+            p = q;
+        }
+        if (p == round) break;  // a trailing partial record
+
+        run_workers(w, nw, worker_parse);
+
+        if (cfg->shard == SHARD_PID) {
+            for (int i = 0; i < nw; i++) w[i].index = index;
+            run_workers(w, nw, worker_shard);
+            for (int i = 0; i < nw; i++) index += w[i].n;
+            continue;
+        }
+
+        // map first touches in chunk order: the serial first-touch order
+        for (int i = 0; i < nw; i++) {
+            for (size_t f = 0; f < w[i].nfirst; f++) {
+                FirstTouch *ft = &w[i].first[f];
+                AddrSpace *sp = sim_space(&s, ft->pid);
+                s.cur = sp;
+                uint64_t *pte = radix_walk(&sp->pt, ft->vpn, 1, NULL);
+                if (*pte & PTE_PRESENT) continue;
+                *pte = (s.next_frame++ << PTE_FRAME_SHIFT) | PTE_PRESENT;
+                sp->pt.mapped++;
+                s.faults++;
+                ft->global = 1;
+            }
+        }
+        s.cur = NULL;
+
+        run_workers(w, nw, worker_translate);
+
+        for (int i = 0; i < nw; i++) {
+            if (!w[i].n) continue;
+            s.switches += w[i].switches;
+            if (have_last && w[i].refs[0].pid != last_pid) s.switches++;
+            last_pid = w[i].refs[w[i].n - 1].pid;
+            have_last = 1;
+            index += w[i].n;
+            if (!cfg->quiet) fwrite(w[i].out.buf, 1, w[i].out.n, stdout);
+        }
+    }
+    double secs = now_sec() - t0;
+
+    for (int i = 0; i < nw; i++) {
+        bad += w[i].bad;
+        s.events_ignored += w[i].events;
+    }
+    if (cfg->shard == SHARD_PID) {
+        for (int i = 0; i < nw; i++) sim_merge(&s, &w[i].sim);
+    } else {
+        // stateless: every reference is one full walk
+        s.translations = index;
+        s.walks = index;
+        s.walk_refs = index * (uint64_t)cfg->levels;
+        s.cycles = s.walk_refs * (uint64_t)cfg->walk_cycles;
+    }
+    s.invalid = bad;
+
+    print_summary(&s);
+    printf("Replay: %llu references in %.3f s (%.1f M/s) | %d threads, %s sharding\n",
+           (unsigned long long)index, secs, secs > 0 ? (double)index / secs / 1e6 : 0.0, nw,
+           cfg->shard == SHARD_PID ? "pid" : "chunk");
+    if (cfg->shard == SHARD_PID && cfg->frames) {
+        uint64_t share = cfg->frames / (uint64_t)nw;
+        if (cfg->frames % (uint64_t)nw) {
+            printf("Frames per worker: %llu-%llu of %llu\n", (unsigned long long)share,
+                   (unsigned long long)share + 1, (unsigned long long)cfg->frames);
+        } else {
+            printf("Frames per worker: %llu of %llu\n", (unsigned long long)share,
+                   (unsigned long long)cfg->frames);
+        }
+    }
+
+    for (int i = 0; i < nw; i++) {
+        if (cfg->shard == SHARD_PID) sim_destroy(&w[i].sim);
+        free(w[i].refs);
+        free(w[i].first);
+        out_free(&w[i].out);
+    }
+    free(w);
+    sim_destroy(&s);
+    return 0;
+}
+
+static inline uint64_t xorshift64(uint64_t *x) {
+    *x ^= *x << 13;
+    *x ^= *x >> 7;
+    *x ^= *x << 17;
+    return *x;
+}
+
+// --kernel-bench: map pages in 512-page runs at random places, then time
+// every batch kernel this CPU supports on the same addresses (1 in 16
+// unmapped) and check each against the scalar one
+static int run_kernel_bench(const Config *cfg, uint64_t pages) {
+    const size_t n = 1 << 22;
+    const int reps = 16;
+    int vpn_bits = cfg->va_bits - cfg->page_shift;
+    uint64_t vpn_mask = vpn_bits >= 64 ? ~0ULL : (1ULL << vpn_bits) - 1;
+    uint64_t rng = 0x9E3779B97F4A7C15ULL;
+
+    RadixTable pt;
+    radix_init(&pt, cfg, NULL);
+    uint64_t *vpns = malloc(pages * sizeof(uint64_t));
+    uint64_t *va = malloc(n * sizeof(uint64_t));
+    uint64_t *pa = malloc(n * sizeof(uint64_t));
+    uint64_t *ref = malloc(n * sizeof(uint64_t));
+    if (!vpns || !va || !pa || !ref) {
+        perror("malloc");
+        return 1;
+    }
+
+    uint64_t base = 0;
+    for (uint64_t p = 0; p < pages; p++) {
+        if (p % 512 == 0) base = (xorshift64(&rng) & vpn_mask) & ~511ULL;
+        vpns[p] = (base + p % 512) & vpn_mask;
+        uint64_t *pte = radix_walk(&pt, vpns[p], 1, NULL);
+        if (!(*pte & PTE_PRESENT)) pt.mapped++;
+        *pte = (p << PTE_FRAME_SHIFT) | PTE_PRESENT;
+    }
+    for (size_t i = 0; i < n; i++) {
+        uint64_t r = xorshift64(&rng);
+        uint64_t vpn = (r & 15) ? vpns[(r >> 4) % pages] : (r >> 4) & vpn_mask;
+        va[i] = (vpn << cfg->page_shift) | (xorshift64(&rng) & ((1ULL << cfg->page_shift) - 1));
+    }
+
+    printf("%d-level table, %llu pages mapped (", cfg->levels, (unsigned long long)pt.mapped);
+    print_bytes(radix_memory(&pt));
+    printf(" of table), %zu addresses x %d\n\n", n, reps);
+    printf("%-8s %10s %12s %9s %10s\n", "kernel", "ns/addr", "M addr/s", "speedup", "faults");
+
+    size_t ref_faults = xlate_scalar(&pt, va, ref, n);
+    double scalar_ns = 0;
+    int failed = 0;
+
+    for (int k = 0; k < NUM_KERNELS; k++) {
+        if (!kernel_supported(k)) {
+            printf("%-8s %10s\n", g_kernels[k].name, "n/a");
+            continue;
+        }
+        size_t faults = g_kernels[k].fn(&pt, va, pa, n);   // warm up
+        if (faults != ref_faults || memcmp(pa, ref, n * sizeof(uint64_t)) != 0) {
+            printf("%-8s MISMATCH against scalar\n", g_kernels[k].name);
+            failed = 1;
+            continue;
+        }
+
+        double t0 = now_sec();
+        for (int r = 0; r < reps; r++) g_kernels[k].fn(&pt, va, pa, n);
+        double ns = (now_sec() - t0) * 1e9 / ((double)n * reps);
+        if (k == 0) scalar_ns = ns;
+
+        printf("%-8s %10.2f %12.1f %8.2fx %10zu\n", g_kernels[k].name, ns, 1e3 / ns,
+               scalar_ns / ns, faults);
+    }
+
+    radix_destroy(&pt);
+    free(vpns);
+    free(va);
+    free(pa);
+    free(ref);
+    return failed;
+}
+
+// ---------------- locality analysis ----------------
+
+// --analyze: one pass computes every page's LRU stack (reuse) distance
+// and the working set size over sliding windows. A Fenwick tree over
+// time holds one mark per page, at its last reference; the distance of a
+// re-reference is the number of marks after the page's previous one, so
+// each reference costs O(log n) instead of a walk down the LRU stack.
+// LRU faults with F frames are the cold misses plus every reference at
+// distance >= F, which gives the whole fault curve at once.
+
+#define MAX_WINDOWS 24
+
+typedef struct {
+    uint32_t *tree;     // 1-based Fenwick tree over reference times
+    size_t n;
+} Fenwick;
+
+static void fenwick_add(Fenwick *f, size_t i, int d) {
+    for (i++; i <= f->n; i += i & -i) f->tree[i] += (uint32_t)d;
+}
+
+// marks at times 0..i-1
+static uint64_t fenwick_prefix(const Fenwick *f, size_t i) {
+    uint64_t sum = 0;
+    for (; i > 0; i -= i & -i) sum += f->tree[i];
+    return sum;
+}
+
+static void print_range(uint64_t lo, uint64_t hi) {
+    char buf[48];
+    if (lo == hi) snprintf(buf, sizeof(buf), "%llu", (unsigned long long)lo);
+    else snprintf(buf, sizeof(buf), "%llu-%llu", (unsigned long long)lo, (unsigned long long)hi);
+    printf("%-22s", buf);
+}
+
+static int run_analyze(const Config *cfg) {
+    Trace t = {0};
+    uint64_t bad = 0;
+
+    if (cfg->trace_path) {
+        size_t len;
+        void *map = map_file(cfg->trace_path, &len);
+        if (!map) return 1;
+        TraceReader rd = {map, (const char *)map + len, cfg->trace_format, 0, cfg->va_bits};
+        trace_load_file(&rd, &t);
+        bad = rd.bad;
+        munmap(map, len);
+    } else {
+        Config quiet = *cfg;
+        quiet.quiet = 1;
+        trace_load_text(stdin, &t, &quiet, &bad);
+    }
+
+    // only references count; process events carry no page
+    size_t kept = 0;
+    for (size_t i = 0; i < t.n; i++) {
+        if (!(t.refs[i].flags & REF_EVENT)) t.refs[kept++] = t.refs[i];
+    }
+    t.n = kept;
+    if (t.n == 0) {
+        fprintf(stderr, "no references to analyze\n");
+        return 1;
+    }
+
+    // windows: 64, 256, ... below the trace length, plus --ws-tau
+    uint64_t tau[MAX_WINDOWS];
+    int ntau = 0;
+    for (uint64_t w = 64; w < t.n && ntau < MAX_WINDOWS - 1; w *= 4) tau[ntau++] = w;
+    if (cfg->ws_tau && cfg->ws_tau <= t.n) {
+        int at = 0;
+        while (at < ntau && tau[at] < cfg->ws_tau) at++;
+        if (at == ntau || tau[at] != cfg->ws_tau) {
+            memmove(&tau[at + 1], &tau[at], (size_t)(ntau - at) * sizeof(uint64_t));
+            tau[at] = cfg->ws_tau;
+            ntau++;
+        }
+    }
+
+    Fenwick fw = {calloc(t.n + 1, sizeof(uint32_t)), t.n};
+    uint64_t *hist = calloc(t.n + 1, sizeof(uint64_t));    // hist[d], d < distinct pages
+    if (!fw.tree || !hist) {
+        perror("calloc");
+        return 1;
+    }
+
+    uint64_t ws_sum[MAX_WINDOWS] = {0}, ws_max[MAX_WINDOWS] = {0};
+    uint64_t timeline[16], cold = 0;
+    int ntimeline = 0;
+    PageMap last;
+    pagemap_init(&last, 1 << 16);
+
+    for (size_t i = 0; i < t.n; i++) {
+        int created;
+        uint64_t *prev = pagemap_get(&last, t.refs[i].pid, t.refs[i].addr >> cfg->page_shift, &created);
+        if (created) {
+            cold++;
+        } else {
+            hist[cold - fenwick_prefix(&fw, (size_t)*prev + 1)]++;
+            fenwick_add(&fw, (size_t)*prev, -1);
+        }
+        fenwick_add(&fw, i, 1);
+        *prev = i;
+
+        // pages marked in (i - tau, i]; all cold pages are marked, so the
+        // total is just the distinct count so far
+        for (int w = 0; w < ntau && tau[w] <= i + 1; w++) {
+            uint64_t ws = cold - fenwick_prefix(&fw, i + 1 - tau[w]);
+            ws_sum[w] += ws;
+            if (ws > ws_max[w]) ws_max[w] = ws;
+            if (tau[w] == cfg->ws_tau && (i + 1) % ((t.n + 15) / 16) == 0 && ntimeline < 16) {
+                timeline[ntimeline++] = ws;
+            }
+        }
+    }
+    pagemap_destroy(&last);
+
+    uint64_t distinct = cold;
+    printf("%llu references | %llu distinct pages | ", (unsigned long long)t.n, (unsigned long long)distinct);
+    print_bytes(1ULL << cfg->page_shift);
+    printf(" pages");
+    if (bad) printf(" | %llu invalid skipped", (unsigned long long)bad);
+    printf("\n\n");
+
+    printf("reuse distance (LRU stack depth)\n");
+    printf("%-22s %14s %9s\n", "distance", "references", "cum %");
+    uint64_t cum = 0;
+    for (uint64_t lo = 0; lo < distinct; lo = lo ? lo * 2 : 1) {
+        uint64_t hi = lo ? lo * 2 - 1 : 0;
+        if (hi >= distinct) hi = distinct - 1;
+        uint64_t c = 0;
+        for (uint64_t d = lo; d <= hi; d++) c += hist[d];
+        cum += c;
+        if (!c) continue;
+        print_range(lo, hi);
+        printf(" %14llu %8.2f%%\n", (unsigned long long)c, 100.0 * cum / t.n);
+    }
+    printf("%-22s %14llu %8.2f%%\n\n", "cold", (unsigned long long)cold, 100.0);
+
+    // faults[F] = cold + references with distance >= F, as a suffix sum
+    printf("LRU faults by memory size\n");
+    printf("%-22s %14s %9s\n", "frames", "faults", "rate");
+    uint64_t *faults = hist;
+    for (uint64_t d = distinct; d-- > 0;) faults[d] += faults[d + 1];
+    for (uint64_t f = 1;; f *= 2) {
+        if (f >= distinct) f = distinct;
+        int extra = cfg->frames && cfg->frames < f && cfg->frames > f / 2;
+        if (extra) {
+            printf("%-22llu %14llu %8.2f%%\n", (unsigned long long)cfg->frames,
+                   (unsigned long long)(cold + faults[cfg->frames]), 100.0 * (cold + faults[cfg->frames]) / t.n);
+        }
+        printf("%-22llu %14llu %8.2f%%\n", (unsigned long long)f,
+               (unsigned long long)(cold + faults[f]), 100.0 * (cold + faults[f]) / t.n);
+        if (f == distinct) break;
+    }
+
+    printf("\nworking set (distinct pages in the last tau references)\n");
+    printf("%-22s %14s %9s\n", "tau", "mean", "max");
+    for (int w = 0; w < ntau; w++) {
+        printf("%-22llu %14.1f %9llu\n", (unsigned long long)tau[w],
+               (double)ws_sum[w] / (double)(t.n - tau[w] + 1), (unsigned long long)ws_max[w]);
+    }
+    if (ntimeline) {
+        printf("\nworking set over time (tau %llu, every %llu references):\n ",
+               (unsigned long long)cfg->ws_tau, (unsigned long long)((t.n + 15) / 16));
+        for (int k = 0; k < ntimeline; k++) printf(" %llu", (unsigned long long)timeline[k]);
+        printf("\n");
+    }
+
+    free(fw.tree);
+    free(hist);
+    free(t.refs);
+    return 0;
+}
+
+static int run_sim(const Config *cfg) {
+    Trace t = {0};
+    uint64_t bad = 0;
+    OutBuf ob, *out = NULL;
+    void *map = NULL;
+    size_t map_len = 0;
+
+    if (!cfg->quiet) print_config(cfg);
+
+    if (cfg->trace_path) {
+        map = map_file(cfg->trace_path, &map_len);
+        if (!map) return 1;
+        TraceReader rd = {map, (const char *)map + map_len, cfg->trace_format, 0, cfg->va_bits};
+        if (cfg->threads > 1) {
+            int rc = run_parallel(cfg, map, map_len);
+            munmap(map, map_len);
+            return rc;
+        }
+        if (!cfg->quiet) {
+            out_init(&ob, OUT_BUF, 0);
+            out = &ob;
+        }
+
+        // only OPT and policy comparisons need the whole trace at once
+        if (cfg->npolicies <= 1 && !(cfg->frames && cfg->policy == POL_OPT)) {
+            int rc = run_stream(cfg, &rd, out);
+            if (out) out_free(out);
+            munmap(map, map_len);
+            return rc;
+        }
+        trace_load_file(&rd, &t);
+        bad = rd.bad;
+        munmap(map, map_len);
+    } else {
+        trace_load_text(stdin, &t, cfg, &bad);
+    }
+
+    // OPT needs to see the future: one backwards pass over the trace
+    uint64_t *next_use = NULL, distinct = 0;
+    int want_opt = 0;
+    for (int i = 0; i < cfg->npolicies; i++) want_opt |= cfg->policies[i] == POL_OPT;
+    if (cfg->frames) {
+        next_use = malloc((t.n ? t.n : 1) * sizeof(uint64_t));
+        if (!next_use) {
+            perror("malloc");
+            return 1;
+        }
+        distinct = trace_next_use(&t, cfg->page_shift, next_use);
+        if (!want_opt) {
+            free(next_use);
+            next_use = NULL;
+        }
+    }
+
+    // a single run prints the full report, several only compare policies
+    int single = cfg->npolicies <= 1;
+    if (!single) {
+        printf("%llu references | %llu distinct pages (compulsory faults) | %llu frames\n\n",
+               (unsigned long long)t.n, (unsigned long long)distinct,
+               (unsigned long long)cfg->frames);
+        printf("%-8s %12s %10s %12s %12s %9s %10s\n",
+               "policy", "faults", "rate", "evictions", "writebacks", "TLB hit", "cycles");
+    }
+
+    for (int p = 0; p < (single ? 1 : cfg->npolicies); p++) {
+        Config run = *cfg;
+        if (cfg->npolicies) run.policy = cfg->policies[p];
+
+        Sim s;
+        sim_init(&s, &run, next_use);
+        s.invalid = bad;
+
+        for (size_t i = 0; i < t.n; i++) {
+            Access a;
+            sim_access(&s, &t.refs[i], i, &a);
+            if (single && out) out_access(out, &t.refs[i], &a);
+            else if (single && !cfg->quiet && (t.refs[i].flags & REF_EVENT)) print_event(&t.refs[i]);
+            else if (single && !cfg->quiet) print_access(&s, t.refs[i].pid, t.refs[i].addr, &a);
+        }
+        if (out) out_flush(out);
+
+        if (single) print_summary(&s);
+        else print_policy_row(&s);
+        sim_destroy(&s);
+    }
+
+    free(next_use);
+    free(t.refs);
+    if (out) out_free(out);
+    return 0;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s                      (quiz mode, reads N and N addresses)\n"
+            "       %s [--preset x86-32|x86-64|x86-64-5] [--page-size SIZE] [--va-bits N]\n"
+            "          [--levels N] [--bits a,b,...] [--pte-size N] [-q]\n"
+            "          [--tlb E[:W[:lru|fifo|random]]] [--tlb2 E[:W[:POLICY]]] [--asid]\n"
+            "          [--tlb-cycles L1,L2] [--walk-cycles N]\n"
+            "          [--frames N [--policy fifo,lru,clock,opt,wsclock|all] [--ws-tau N]]\n"
+            "          [--trace FILE [--format text|bin|ref]] [--kernel scalar|avx2|avx512]\n"
+            "          [--threads N [--shard chunk|pid]] [--table radix|hashed|inverted]\n"
+            "          [--huge SIZE,... [--promote eager|PERCENT]]\n"
+            "          [--cache SIZE:WAYS[:LINE]]... [--cache-mode nine|inclusive|exclusive]\n"
+            "          [--buddy SIZE [--slab]]\n"
+            "          < addresses\n"
+            "       %s [page size options] [--trace FILE] [--frames N] [--ws-tau N] --analyze\n"
+            "       %s [page table options] --kernel-bench PAGES\n",
+            prog, prog, prog, prog);
+}
+
+// the original quiz: 4-entry flat page table with 1024-byte pages
+static int run_quiz(void) {
 
     // predefined page table for this process
     int pageTable[NUM_PAGES] = {5, 2, 9, 1};
@@ -48,4 +3976,318 @@ int main(void) {
     }
 
     return 0;
-}
\ No newline at end of file
+}
+
+int main(int argc, char *argv[]) {
+
+    if (argc == 1) return run_quiz();
+
+    Config cfg;
+    memset(&cfg, 0, sizeof(cfg));
+    apply_preset(&cfg, "x86-64");
+    cfg.tlb_cycles[0] = 1;
+    cfg.tlb_cycles[1] = 7;
+    cfg.walk_cycles = 30;
+    cfg.policy = POL_LRU;
+    cfg.ws_tau = 1000;
+
+    int levels_set = 0, bits_set = 0, va_set = 0, pte_set = 0;
+    uint64_t bench_pages = 0, buddy_bytes = 0;
+    int analyze = 0;
+    char *huge = NULL;
+
+    static const struct option long_opts[] = {
+        {"preset",    required_argument, 0, 'P'},
+        {"page-size", required_argument, 0, 's'},
+        {"va-bits",   required_argument, 0, 'v'},
+        {"levels",    required_argument, 0, 'l'},
+        {"bits",      required_argument, 0, 'b'},
+        {"pte-size",  required_argument, 0, 'e'},
+        {"tlb",       required_argument, 0, 'T'},
+        {"tlb2",      required_argument, 0, 'U'},
+        {"asid",      no_argument,       0, 'A'},
+        {"tlb-cycles",  required_argument, 0, 'C'},
+        {"walk-cycles", required_argument, 0, 'W'},
+        {"frames",    required_argument, 0, 'F'},
+        {"policy",    required_argument, 0, 'R'},
+        {"ws-tau",    required_argument, 0, 'w'},
+        {"trace",     required_argument, 0, 't'},
+        {"format",    required_argument, 0, 'f'},
+        {"kernel",    required_argument, 0, 'k'},
+        {"kernel-bench", required_argument, 0, 'K'},
+        {"threads",   required_argument, 0, 'j'},
+        {"shard",     required_argument, 0, 'S'},
+        {"table",     required_argument, 0, 'H'},
+        {"huge",      required_argument, 0, 'G'},
+        {"promote",   required_argument, 0, 'M'},
+        {"analyze",   no_argument,       0, 'a'},
+        {"cache",     required_argument, 0, 'c'},
+        {"cache-mode", required_argument, 0, 'm'},
+        {"buddy",     required_argument, 0, 'B'},
+        {"slab",      no_argument,       0, 'L'},
+        {"quiet",     no_argument,       0, 'q'},
+        {"help",      no_argument,       0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "qh", long_opts, NULL)) != -1) {
+        uint64_t size;
+        switch (opt) {
+        case 'P':
+            if (apply_preset(&cfg, optarg) != 0) {
+                fprintf(stderr, "unknown preset: %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 's':
+            if (parse_size(optarg, &size) != 0 || log2_exact(size) < 0) {
+                fprintf(stderr, "page size must be a power of two: %s\n", optarg);
+                return 1;
+            }
+            // keep the address width when only the page size changes
+            if (!va_set) va_set = 1;
+            cfg.page_shift = log2_exact(size);
+            break;
+        case 'v':
+            cfg.va_bits = atoi(optarg);
+            va_set = 1;
+            break;
+        case 'l':
+            cfg.levels = atoi(optarg);
+            if (cfg.levels < 1 || cfg.levels > MAX_LEVELS) {
+                fprintf(stderr, "levels must be 1..%d\n", MAX_LEVELS);
+                return 1;
+            }
+            levels_set = 1;
+            break;
+        case 'b': {
+            cfg.levels = 0;
+            for (char *p = strtok(optarg, ","); p; p = strtok(NULL, ",")) {
+                if (cfg.levels >= MAX_LEVELS) {
+                    fprintf(stderr, "at most %d levels\n", MAX_LEVELS);
+                    return 1;
+                }
+                cfg.bits[cfg.levels++] = atoi(p);
+            }
+            bits_set = 1;
+            break;
+        }
+        case 'e':
+            cfg.pte_size = atoi(optarg);
+            pte_set = 1;
+            break;
+        case 'T':
+        case 'U': {
+            int i = (opt == 'T') ? 0 : 1;
+            if (parse_tlb(optarg, &cfg.tlb[i]) != 0) {
+                fprintf(stderr, "bad TLB spec (ENTRIES[:WAYS[:lru|fifo|random]]): %s\n", optarg);
+                return 1;
+            }
+            if (cfg.ntlb < i + 1) cfg.ntlb = i + 1;
+            break;
+        }
+        case 'A':
+            cfg.asid = 1;
+            break;
+        case 'C':
+            if (sscanf(optarg, "%d,%d", &cfg.tlb_cycles[0], &cfg.tlb_cycles[1]) < 1) {
+                fprintf(stderr, "bad TLB cycles: %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'W':
+            cfg.walk_cycles = atoi(optarg);
+            break;
+        case 'F':
+            cfg.frames = strtoull(optarg, NULL, 0);
+            if (cfg.frames == 0 || cfg.frames > INT32_MAX) {
+                fprintf(stderr, "bad frame count: %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'R':
+            if (parse_policies(optarg, &cfg) != 0) {
+                fprintf(stderr, "bad policy list (fifo,lru,clock,opt,wsclock or all): %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'w':
+            cfg.ws_tau = strtoull(optarg, NULL, 0);
+            break;
+        case 't':
+            cfg.trace_path = optarg;
+            break;
+        case 'k':
+            if (pick_kernel(optarg) < 0) {
+                fprintf(stderr, "kernel not available on this CPU: %s\n", optarg);
+                return 1;
+            }
+            cfg.kernel = optarg;
+            break;
+        case 'j':
+            cfg.threads = atoi(optarg);
+            if (cfg.threads < 1 || cfg.threads > 1024) {
+                fprintf(stderr, "bad thread count: %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'S':
+            if (strcmp(optarg, "chunk") == 0) cfg.shard = SHARD_CHUNK;
+            else if (strcmp(optarg, "pid") == 0) cfg.shard = SHARD_PID;
+            else {
+                fprintf(stderr, "unknown sharding: %s (chunk or pid)\n", optarg);
+                return 1;
+            }
+            break;
+        case 'H':
+            if (strcmp(optarg, "radix") == 0) cfg.table = TABLE_RADIX;
+            else if (strcmp(optarg, "hashed") == 0) cfg.table = TABLE_HASHED;
+            else if (strcmp(optarg, "inverted") == 0) cfg.table = TABLE_INVERTED;
+            else {
+                fprintf(stderr, "unknown page table: %s (radix, hashed or inverted)\n", optarg);
+                return 1;
+            }
+            break;
+        case 'G':
+            huge = optarg;
+            break;
+        case 'M':
+            if (strcmp(optarg, "eager") == 0) {
+                cfg.promote_pct = 0;
+            } else {
+                cfg.promote_pct = atoi(optarg);
+                if (cfg.promote_pct < 1 || cfg.promote_pct > 100) {
+                    fprintf(stderr, "--promote takes eager or a percentage 1..100: %s\n", optarg);
+                    return 1;
+                }
+            }
+            break;
+        case 'a':
+            analyze = 1;
+            break;
+        case 'c':
+            if (cfg.ncache == MAX_CACHES) {
+                fprintf(stderr, "at most %d cache levels\n", MAX_CACHES);
+                return 1;
+            }
+            if (parse_cache(optarg, &cfg.cache[cfg.ncache]) != 0) {
+                fprintf(stderr, "bad cache spec (SIZE:WAYS[:LINE]): %s\n", optarg);
+                return 1;
+            }
+            if (cfg.ncache && cfg.cache[cfg.ncache].line != cfg.cache[0].line) {
+                fprintf(stderr, "every cache level needs the same line size\n");
+                return 1;
+            }
+            cfg.ncache++;
+            break;
+        case 'B':
+            if (parse_size(optarg, &buddy_bytes) != 0 || buddy_bytes == 0) {
+                fprintf(stderr, "bad memory size: %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'L':
+            cfg.slab = 1;
+            break;
+        case 'm':
+            if (strcmp(optarg, "inclusive") == 0) cfg.cache_mode = CACHE_INCLUSIVE;
+            else if (strcmp(optarg, "exclusive") == 0) cfg.cache_mode = CACHE_EXCLUSIVE;
+            else if (strcmp(optarg, "nine") == 0) cfg.cache_mode = CACHE_NINE;
+            else {
+                fprintf(stderr, "unknown cache mode: %s (inclusive, exclusive or nine)\n", optarg);
+                return 1;
+            }
+            break;
+        case 'K':
+            bench_pages = strtoull(optarg, NULL, 0);
+            if (bench_pages == 0) {
+                fprintf(stderr, "bad page count: %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'f':
+            if (strcmp(optarg, "text") == 0) cfg.trace_format = FMT_TEXT;
+            else if (strcmp(optarg, "bin") == 0) cfg.trace_format = FMT_BIN;
+            else if (strcmp(optarg, "ref") == 0) cfg.trace_format = FMT_REF;
+            else {
+                fprintf(stderr, "unknown trace format: %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'q':
+            cfg.quiet = 1;
+            break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+
+    if (finish_config(&cfg, levels_set, bits_set, va_set) != 0) return 1;
+    if (!pte_set) cfg.pte_size = (cfg.va_bits <= 32) ? 4 : 8;
+    if (cfg.ntlb == 2 && cfg.tlb[0].entries == 0) {
+        fprintf(stderr, "--tlb2 needs an L1 TLB (--tlb)\n");
+        return 1;
+    }
+    if (cfg.npolicies && !cfg.frames) {
+        fprintf(stderr, "--policy needs a frame limit (--frames)\n");
+        return 1;
+    }
+    if (cfg.npolicies == 1) cfg.policy = cfg.policies[0];
+
+    if (huge) {
+        if (parse_huge(huge, &cfg) != 0) return 1;
+        if (cfg.table != TABLE_RADIX || cfg.frames || cfg.threads > 1) {
+            fprintf(stderr, "--huge needs the radix table, unlimited memory and one thread\n");
+            return 1;
+        }
+    }
+
+    if (buddy_bytes) {
+        cfg.buddy_frames = buddy_bytes >> cfg.page_shift;
+        if (cfg.buddy_frames == 0 || cfg.buddy_frames >= NO_LINK) {
+            fprintf(stderr, "--buddy needs between one page and 2^32 frames of memory\n");
+            return 1;
+        }
+        if (cfg.frames || cfg.threads > 1) {
+            fprintf(stderr, "--buddy replaces --frames and runs on one thread\n");
+            return 1;
+        }
+    }
+    if (cfg.slab && !cfg.buddy_frames) {
+        fprintf(stderr, "--slab needs physical memory to take slabs from (--buddy)\n");
+        return 1;
+    }
+
+    if (bench_pages) return run_kernel_bench(&cfg, bench_pages);
+    if (analyze) return run_analyze(&cfg);
+
+    if (cfg.threads > 1) {
+        if (cfg.table != TABLE_RADIX) {
+            fprintf(stderr, "--threads needs the radix page table\n");
+            return 1;
+        }
+        if (!cfg.trace_path) {
+            fprintf(stderr, "--threads needs a trace file (--trace)\n");
+            return 1;
+        }
+        if (cfg.shard == SHARD_CHUNK && (cfg.ntlb || cfg.frames || cfg.ncache)) {
+            fprintf(stderr, "chunked replay is for stateless translation (no --tlb/--frames/--cache); "
+                            "use --shard pid\n");
+            return 1;
+        }
+        if (cfg.shard == SHARD_PID && cfg.frames && cfg.frames < (uint64_t)cfg.threads) {
+            fprintf(stderr, "--shard pid splits --frames between the threads; "
+                            "give at least one frame per thread\n");
+            return 1;
+        }
+        if (cfg.npolicies > 1 || (cfg.frames && cfg.policy == POL_OPT)) {
+            fprintf(stderr, "--threads can't compare policies or run OPT\n");
+            return 1;
+        }
+        if (cfg.shard == SHARD_PID) cfg.quiet = 1;
+    }
+
+    return run_sim(&cfg);
+}
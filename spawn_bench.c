@@ -0,0 +1,485 @@
+/*
+    spawn_bench.c
+    Process-spawn benchmark: fork, vfork, posix_spawn and clone3
+
+    Lab2.c and launcher start every child with fork + execvp. This measures
+    what that costs compared to the other ways of starting a program, and
+    how the cost grows with the parent's size, since fork has to copy the
+    parent's page tables while vfork / posix_spawn / clone3(CLONE_VM|
+    CLONE_VFORK) share the parent's memory until the child execs.
+
+    For every parent RSS size (memory is mmap'd and written so it is really
+    resident) and every method it reports:
+      - spawn-to-exec: start of the spawn call until the child has exec'd,
+        seen as EOF on a close-on-exec pipe
+      - spawn-to-exit: start of the spawn call until waitpid returns
+      - spawns/s: children started and reaped back to back, with up to
+        -p of them outstanding at once
+
+    Usage:
+        ./spawn_bench [-n iterations] [-w warmup] [-m sizes] [-M methods]
+                      [-p outstanding] [-x program] [-H]
+
+    -m   comma separated RSS sizes, K/M/G suffixes (default 10M,100M,1G,4G);
+         sizes that don't fit in MemAvailable are skipped
+    -M   comma separated subset of fork,vfork,posix_spawn,clone3
+    -x   program to exec, run with no arguments (default /bin/true)
+    -H   allow transparent huge pages in the ballast (default is 4K pages,
+         which is what a fork-heavy server's heap usually looks like)
+
+    clone3 is called directly (glibc has no wrapper): on x86-64 through a
+    small asm stub that runs the child on its own stack; elsewhere it is
+    reported as unavailable.
+*/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <spawn.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+
+#ifndef CLONE_VM
+#define CLONE_VM 0x00000100
+#endif
+#ifndef CLONE_VFORK
+#define CLONE_VFORK 0x00004000
+#endif
+
+#define MAX_SIZES 16
+#define CHILD_STACK (64 * 1024)
+
+extern char **environ;
+
+typedef enum { M_FORK, M_VFORK, M_POSIX_SPAWN, M_CLONE3, NUM_METHODS } Method;
+
+static const char *method_names[NUM_METHODS] = {"fork", "vfork", "posix_spawn", "clone3"};
+
+static const char *g_prog = "/bin/true";
+static char *g_argv[2];
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// ---------------- clone3 ----------------
+
+// struct clone_args, version 0 (Linux 5.3); spelled out so we don't need
+// <linux/sched.h>, which clashes with <sched.h>
+typedef struct {
+    uint64_t flags;
+    uint64_t pidfd;
+    uint64_t child_tid;
+    uint64_t parent_tid;
+    uint64_t exit_signal;
+    uint64_t stack;
+    uint64_t stack_size;
+    uint64_t tls;
+} CloneArgs;
+
+// the child shares our memory, so it may only call execve and exit
+static int clone_child(void *arg) {
+    (void)arg;
+    execve(g_prog, g_argv, environ);
+    return 127;
+}
+
+#if defined(__x86_64__) && defined(SYS_clone3)
+// The child comes back from the syscall on its new stack with every other
+// register intact, so it can't return into C code; call fn there and exit
+// with its result (this is what glibc's own clone3 stub does).
+static long clone3_run(CloneArgs *args, int (*fn)(void *), void *arg) {
+    long ret;
+    register void *r12 __asm__("r12") = (void *)fn;
+    register void *r13 __asm__("r13") = arg;
+
+    __asm__ volatile(
+        "syscall\n\t"
+        "test %%rax, %%rax\n\t"
+        "jnz 1f\n\t"
+        "xor %%ebp, %%ebp\n\t"
+        "mov %%r13, %%rdi\n\t"
+        "call *%%r12\n\t"
+        "mov %%eax, %%edi\n\t"
+        "mov %[nr_exit], %%eax\n\t"
+        "syscall\n\t"
+        "hlt\n"
+        "1:\n\t"
+        : "=a"(ret)
+        : "a"((long)SYS_clone3), "D"(args), "S"(sizeof(CloneArgs)),
+          "r"(r12), "r"(r13), [nr_exit] "i"(SYS_exit)
+        : "rcx", "r11", "memory");
+    return ret;
+}
+#else
+static long clone3_run(CloneArgs *args, int (*fn)(void *), void *arg) {
+    (void)args; (void)fn; (void)arg;
+    return -ENOSYS;
+}
+#endif
+
+// the parent sleeps until the child execs (CLONE_VFORK), so one stack is enough
+static char g_child_stack[CHILD_STACK] __attribute__((aligned(16)));
+
+// ---------------- spawning ----------------
+
+// Start g_prog with the given method. Returns the pid, or -1 with errno set.
+static pid_t spawn(Method m) {
+    pid_t pid;
+
+    switch (m) {
+    case M_FORK:
+        pid = fork();
+        if (pid == 0) {
+            execve(g_prog, g_argv, environ);
+            _exit(127);
+        }
+        return pid;
+
+    case M_VFORK:
+        pid = vfork();
+        if (pid == 0) {
+            execve(g_prog, g_argv, environ);
+            _exit(127);
+        }
+        return pid;
+
+    case M_POSIX_SPAWN: {
+        int err = posix_spawn(&pid, g_prog, NULL, NULL, g_argv, environ);
+        if (err) {
+            errno = err;
+            return -1;
+        }
+        return pid;
+    }
+
+    case M_CLONE3: {
+        CloneArgs args;
+        memset(&args, 0, sizeof(args));
+        args.flags = CLONE_VM | CLONE_VFORK;
+        args.exit_signal = SIGCHLD;
+        args.stack = (uint64_t)(uintptr_t)g_child_stack;
+        args.stack_size = sizeof(g_child_stack);
+
+        long r = clone3_run(&args, clone_child, NULL);
+        if (r < 0) {
+            errno = (int)-r;
+            return -1;
+        }
+        return (pid_t)r;
+    }
+
+    default:
+        errno = EINVAL;
+        return -1;
+    }
+}
+
+// One timed spawn. exec_ns / exit_ns are measured from just before the call.
+// Returns -1 if the method failed (errno set), -2 if the program failed.
+static int spawn_once(Method m, uint64_t *exec_ns, uint64_t *exit_ns) {
+    int fds[2];
+    if (pipe2(fds, O_CLOEXEC) != 0) {
+        perror("pipe2");
+        return -1;
+    }
+
+    uint64_t t0 = now_ns();
+    pid_t pid = spawn(m);
+    if (pid < 0) {
+        int err = errno;
+        close(fds[0]);
+        close(fds[1]);
+        errno = err;
+        return -1;
+    }
+
+    // the child's copy of the write end closes when it execs
+    close(fds[1]);
+    char c;
+    while (read(fds[0], &c, 1) < 0 && errno == EINTR) {}
+    uint64_t t1 = now_ns();
+    close(fds[0]);
+
+    int status;
+    if (waitpid(pid, &status, 0) < 0) {
+        perror("waitpid");
+        return -1;
+    }
+    uint64_t t2 = now_ns();
+
+    // the spawn worked but the program didn't: report that as the program's
+    // fault, not as a missing spawn method
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        if (WIFEXITED(status))
+            fprintf(stderr, "%s: %s exited with %d\n", method_names[m], g_prog, WEXITSTATUS(status));
+        else
+            fprintf(stderr, "%s: %s killed by signal %d\n", method_names[m], g_prog, WTERMSIG(status));
+        errno = ECHILD;
+        return -2;
+    }
+
+    *exec_ns = t1 - t0;
+    *exit_ns = t2 - t0;
+    return 0;
+}
+
+// Start count children as fast as possible, at most outstanding at a time.
+// Returns spawns per second, or -1.
+static double spawn_rate(Method m, int count, int outstanding) {
+    int running = 0, started = 0;
+    uint64_t t0 = now_ns();
+
+    while (started < count || running > 0) {
+        while (started < count && running < outstanding) {
+            if (spawn(m) < 0) {
+                if (errno == EAGAIN && running > 0) break;  // hit a process limit
+                perror(method_names[m]);
+                return -1;
+            }
+            started++;
+            running++;
+        }
+
+        int status;
+        if (waitpid(-1, &status, 0) < 0) {
+            if (errno == EINTR) continue;
+            perror("waitpid");
+            return -1;
+        }
+        running--;
+    }
+
+    return count / ((now_ns() - t0) / 1e9);
+}
+
+static int cmp_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+// nearest-rank percentile of a sorted array
+static uint64_t percentile(const uint64_t *v, int n, double p) {
+    int idx = (int)(p * n + 0.999999) - 1;
+    if (idx < 0) idx = 0;
+    if (idx >= n) idx = n - 1;
+    return v[idx];
+}
+
+static uint64_t mean(const uint64_t *v, int n) {
+    uint64_t sum = 0;
+    for (int i = 0; i < n; i++) sum += v[i];
+    return sum / (uint64_t)n;
+}
+
+// ---------------- parent memory ----------------
+
+// "10M" -> bytes; 0 on bad input
+static size_t parse_size(const char *s) {
+    char *end;
+    unsigned long long v = strtoull(s, &end, 10);
+    switch (*end) {
+    case 'k': case 'K': v <<= 10; end++; break;
+    case 'm': case 'M': v <<= 20; end++; break;
+    case 'g': case 'G': v <<= 30; end++; break;
+    default: break;
+    }
+    if (*end || end == s) return 0;
+    return (size_t)v;
+}
+
+static size_t mem_available(void) {
+    FILE *f = fopen("/proc/meminfo", "r");
+    if (!f) return SIZE_MAX;
+
+    char line[256];
+    size_t kb = SIZE_MAX;
+    while (fgets(line, sizeof(line), f)) {
+        unsigned long long v;
+        if (sscanf(line, "MemAvailable: %llu kB", &v) == 1) {
+            kb = (size_t)v;
+            break;
+        }
+    }
+    fclose(f);
+    return kb == SIZE_MAX ? SIZE_MAX : kb * 1024;
+}
+
+// current resident set of this process, from /proc/self/statm
+static size_t rss_bytes(void) {
+    FILE *f = fopen("/proc/self/statm", "r");
+    if (!f) return 0;
+    unsigned long size, resident = 0;
+    if (fscanf(f, "%lu %lu", &size, &resident) != 2) resident = 0;
+    fclose(f);
+    return resident * (size_t)sysconf(_SC_PAGESIZE);
+}
+
+// Map and write bytes of ballast so it is resident (and private dirty,
+// which is what fork has to set up copy-on-write for).
+static void *ballast_alloc(size_t bytes, int huge) {
+    void *p = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) return NULL;
+
+    madvise(p, bytes, huge ? MADV_HUGEPAGE : MADV_NOHUGEPAGE);
+    long page = sysconf(_SC_PAGESIZE);
+    for (size_t off = 0; off < bytes; off += (size_t)page) ((volatile char *)p)[off] = 1;
+    return p;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [-n iterations] [-w warmup] [-m sizes] [-M methods] [-p outstanding] "
+            "[-x program] [-H]\n",
+            prog);
+}
+
+int main(int argc, char *argv[]) {
+    const char *sizes_arg = "10M,100M,1G,4G";
+    const char *methods_arg = "fork,vfork,posix_spawn,clone3";
+    int iters = 200;
+    int warmup = 20;
+    int outstanding = 4;
+    int huge = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:w:m:M:p:x:Hh")) != -1) {
+        switch (opt) {
+        case 'n': iters = atoi(optarg); break;
+        case 'w': warmup = atoi(optarg); break;
+        case 'm': sizes_arg = optarg; break;
+        case 'M': methods_arg = optarg; break;
+        case 'p': outstanding = atoi(optarg); break;
+        case 'x': g_prog = optarg; break;
+        case 'H': huge = 1; break;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (iters <= 0 || warmup < 0 || outstanding <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    g_argv[0] = (char *)g_prog;
+    g_argv[1] = NULL;
+    if (access(g_prog, X_OK) != 0) {
+        perror(g_prog);
+        return 1;
+    }
+
+    // sizes
+    size_t sizes[MAX_SIZES];
+    int nsizes = 0;
+    char *list = strdup(sizes_arg);
+    for (char *tok = strtok(list, ","); tok; tok = strtok(NULL, ",")) {
+        size_t b = parse_size(tok);
+        if (b == 0 || nsizes >= MAX_SIZES) {
+            fprintf(stderr, "bad size list: %s\n", sizes_arg);
+            return 1;
+        }
+        sizes[nsizes++] = b;
+    }
+    free(list);
+
+    // methods
+    int want[NUM_METHODS] = {0};
+    list = strdup(methods_arg);
+    for (char *tok = strtok(list, ","); tok; tok = strtok(NULL, ",")) {
+        int m = 0;
+        while (m < NUM_METHODS && strcmp(tok, method_names[m]) != 0) m++;
+        if (m == NUM_METHODS) {
+            fprintf(stderr, "unknown method: %s\n", tok);
+            return 1;
+        }
+        want[m] = 1;
+    }
+    free(list);
+
+    uint64_t *exec_lat = malloc(sizeof(uint64_t) * (size_t)iters);
+    uint64_t *exit_lat = malloc(sizeof(uint64_t) * (size_t)iters);
+    if (!exec_lat || !exit_lat) {
+        perror("malloc");
+        return 1;
+    }
+
+    printf("program: %s | iterations: %d | warmup: %d | outstanding: %d | pages: %s\n",
+           g_prog, iters, warmup, outstanding, huge ? "THP allowed" : "4K");
+
+    for (int si = 0; si < nsizes; si++) {
+        // leave some room so the machine doesn't start swapping
+        size_t avail = mem_available();
+        if (avail != SIZE_MAX && sizes[si] > avail / 10 * 9) {
+            printf("\nRSS %zu MB: skipped, only %zu MB available\n",
+                   sizes[si] >> 20, avail >> 20);
+            continue;
+        }
+
+        void *ballast = ballast_alloc(sizes[si], huge);
+        if (!ballast) {
+            printf("\nRSS %zu MB: skipped, mmap failed: %s\n", sizes[si] >> 20, strerror(errno));
+            continue;
+        }
+
+        printf("\nparent RSS: %zu MB (asked for %zu MB)\n", rss_bytes() >> 20, sizes[si] >> 20);
+        printf("%-12s %10s %10s %10s %10s %10s %10s %10s\n", "method",
+               "exec p50", "exec p99", "exec mean", "exit p50", "exit p99", "exit mean", "spawns/s");
+
+        for (int m = 0; m < NUM_METHODS; m++) {
+            if (!want[m]) continue;
+
+            uint64_t ex, ez;
+            int failed = 0;
+            for (int i = 0; i < warmup + iters; i++) {
+                failed = spawn_once((Method)m, &ex, &ez);
+                if (failed) break;
+                if (i >= warmup) {
+                    exec_lat[i - warmup] = ex;
+                    exit_lat[i - warmup] = ez;
+                }
+            }
+            if (failed == -2) {
+                printf("%-12s failed: %s did not exit with 0\n", method_names[m], g_prog);
+                continue;
+            }
+            if (failed) {
+                printf("%-12s unavailable: %s\n", method_names[m], strerror(errno));
+                continue;
+            }
+
+            double rate = spawn_rate((Method)m, iters, outstanding);
+
+            // latencies in microseconds
+            uint64_t exec_mean = mean(exec_lat, iters), exit_mean = mean(exit_lat, iters);
+            qsort(exec_lat, (size_t)iters, sizeof(uint64_t), cmp_u64);
+            qsort(exit_lat, (size_t)iters, sizeof(uint64_t), cmp_u64);
+            printf("%-12s %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f %10.0f\n", method_names[m],
+                   percentile(exec_lat, iters, 0.50) / 1e3,
+                   percentile(exec_lat, iters, 0.99) / 1e3,
+                   exec_mean / 1e3,
+                   percentile(exit_lat, iters, 0.50) / 1e3,
+                   percentile(exit_lat, iters, 0.99) / 1e3,
+                   exit_mean / 1e3,
+                   rate);
+        }
+
+        munmap(ballast, sizes[si]);
+    }
+
+    printf("\n(latencies in microseconds from the start of the spawn call)\n");
+
+    free(exec_lat);
+    free(exit_lat);
+    return 0;
+}